@@ -129,43 +129,73 @@ static int variable_read(struct ise_handle*dev, const char*name, unsigned bank)
       return 0;
 }
 
+/*
+ * The raw dump keeps up to RAW_WINDOW tagged reads in flight. That is
+ * the default ring depth of a channel. More than that can fill the
+ * out ring while the firmware waits for the responses to be read,
+ * and then neither side can move.
+ */
+# define RAW_WINDOW 4
+
+static int raw_request(struct ise_handle*dev, const char*name,
+		       unsigned bank, unsigned idx)
+{
+      ise_error_t ise_rc;
+      char buf[128];
+      char tag[64];
+
+      sprintf(buf, "get eeprom %u %u %u %u %u %u %u %u %u",
+	      bank, idx+0,idx+1,idx+2,idx+3,idx+4,idx+5,idx+6,idx+7);
+      sprintf(tag, "read%u", idx);
+      ise_rc = ise_request(dev, 3, tag, buf);
+      if (ise_rc != ISE_OK) {
+	    fprintf(stderr, "%s: error writing channel 3: %s\n",
+		    name, ise_error_msg(ise_rc));
+	    return -1;
+      }
+
+      return 0;
+}
+
 static int raw_dump(struct ise_handle*dev, const char*name, unsigned bank)
 {
       unsigned idx, jdx;
       ise_error_t ise_rc;
       char buf[128];
-      char cookie[64];
+      char tag[64];
 
-      for (idx = 0 ;  idx < 256 ;  idx += 8) {
-	    sprintf(buf, "<read%u>get eeprom %u %u %u %u %u %u %u %u %u",
-		    idx,bank, idx+0,idx+1,idx+2,idx+3,idx+4,idx+5,idx+6,idx+7);
-	    ise_rc = ise_writeln(dev, 3, buf);
+	/* Prime the pipeline, then send another read as each response
+	   is collected, so that RAW_WINDOW reads share each round
+	   trip. */
+      for (idx = 0 ;  idx < 256 && idx < 8*RAW_WINDOW ;  idx += 8) {
+	    if (raw_request(dev, name, bank, idx) < 0)
+		  return -1;
+      }
 
-	    sprintf(cookie, "<read%u>", idx);
+      for (idx = 0 ;  idx < 256 ;  idx += 8) {
+	    sprintf(tag, "read%u", idx);
 
 	    printf("%02x:", idx);
 	    for (jdx = 0 ;  jdx < 8 ;  jdx += 1) {
 		  int val;
-		  ise_rc = ise_readln(dev, 3, buf, sizeof buf);
+		  ise_rc = ise_response(dev, 3, tag, buf, sizeof buf);
 		  if (ise_rc != ISE_OK) {
 			fprintf(stderr, "%s: error reading channel 3: %s\n",
 				name, ise_error_msg(ise_rc));
 			return -1;
 		  }
 
-		  if (strncmp(cookie,buf,strlen(cookie)) != 0) {
-			fprintf(stderr, "%s: Bad response: %s\n",
-				name, buf);
-			return -1;
-		  }
-
-		  val = strtol(buf+strlen(cookie),0,16);
+		  val = strtol(buf,0,16);
 		  if (isgraph(val))
 			printf(" %2c", val);
 		  else
 			printf(" %02x", val);
 	    }
 	    printf("\n");
+
+	    if (idx + 8*RAW_WINDOW < 256
+		&& raw_request(dev, name, bank, idx + 8*RAW_WINDOW) < 0)
+		  return -1;
       }
       return 0;
 }
@@ -0,0 +1,69 @@
+#ifndef __bench_H
+#define __bench_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/*
+ * Common bits of the libiseio timing programs. Each program takes an
+ * optional device name and firmware name on the command line. The
+ * default is the bench.plg plugin in the current directory, so the
+ * programs run without any hardware. A real board needs a firmware
+ * that speaks the bench.plg protocol on channel 6.
+ */
+# include  <libiseio.h>
+# include  <stdio.h>
+# include  <time.h>
+
+# define BENCH_CHANNEL 6
+
+static double bench_clock(void)
+{
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct ise_handle* bench_open(int argc, char*argv[])
+{
+      const char*name = argc > 1? argv[1] : "plug:bench";
+      const char*firm = argc > 2? argv[2] : "bench";
+      struct ise_handle*dev;
+      ise_error_t rc;
+
+	/* The ise_restart that follows resets the board, unless it
+	   finds the same firmware already running. */
+      dev = ise_open_lazy(name);
+      if (dev == 0) {
+	    fprintf(stderr, "%s: Unable to open ISE device.\n", name);
+	    return 0;
+      }
+
+      rc = ise_restart(dev, firm);
+      if (rc != ISE_OK) {
+	    fprintf(stderr, "%s: Unable to start %s: %s\n", name, firm,
+		    ise_error_msg(rc));
+	    ise_close(dev);
+	    return 0;
+      }
+
+      return dev;
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/*
+ * Show that the cost of finding an open channel does not depend on
+ * how many channels are open. Open channels one at a time, and after
+ * each open time many lookups of the first and of the newest
+ * channel. The lookups go through ise_ring_in_buffer, which on a
+ * plug device does nothing but find the channel, so run this against
+ * the default "plug:bench" device. (The plug library has only 256
+ * channels, and does not answer an open of any other, so a plug
+ * device stops at 255. A board goes to 494.)
+ *
+ * Usage: bench_lookup [<device> [<firm>]]
+ */
+# include  "bench.h"
+# include  <string.h>
+
+# define BENCH_LOOKUPS 10000000
+# define BENCH_MAX_CHANNEL 494
+# define BENCH_MAX_PLUG_CHANNEL 255
+
+static double time_lookups(struct ise_handle*dev, unsigned cid)
+{
+      const void*buf;
+      size_t count;
+      double t_start, t_end;
+      unsigned idx;
+
+      t_start = bench_clock();
+      for (idx = 0 ;  idx < BENCH_LOOKUPS ;  idx += 1)
+	    ise_ring_in_buffer(dev, cid, &buf, &count);
+      t_end = bench_clock();
+
+      return (t_end - t_start) / BENCH_LOOKUPS * 1e9;
+}
+
+int main(int argc, char*argv[])
+{
+      struct ise_handle*dev;
+      unsigned cid, nopen, max_cid;
+
+      dev = bench_open(argc, argv);
+      if (dev == 0)
+	    return 1;
+
+      if (argc < 2 || strncmp(argv[1], "plug:", 5) == 0)
+	    max_cid = BENCH_MAX_PLUG_CHANNEL;
+      else
+	    max_cid = BENCH_MAX_CHANNEL;
+
+      nopen = 0;
+      for (cid = 1 ;  cid <= max_cid ;  cid += 1) {
+	    ise_error_t rc = ise_channel(dev, cid);
+	    if (rc != ISE_OK) {
+		  fprintf(stderr, "Stopped at channel %u: %s\n",
+			  cid, ise_error_msg(rc));
+		  break;
+	    }
+	    nopen += 1;
+
+	    if (nopen == 1 || nopen % 32 == 0)
+		  printf("%3u open: first %6.1fns, newest %6.1fns per lookup\n",
+			 nopen, time_lookups(dev, 1), time_lookups(dev, cid));
+      }
+
+      if (nopen > 1 && nopen % 32 != 0)
+	    printf("%3u open: first %6.1fns, newest %6.1fns per lookup\n",
+		   nopen, time_lookups(dev, 1), time_lookups(dev, nopen));
+
+      ise_close(dev);
+      return 0;
+}
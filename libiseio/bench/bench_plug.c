@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/*
+ * This is the plugin side of the libiseio timing programs. Build it
+ * as bench.plg and run the timing programs in the same directory with
+ * the device "plug:bench". It speaks a tiny line protocol on channel 6:
+ *
+ *   SYNC
+ *	Reply "DONE". All the lines sent before the SYNC have been
+ *	read by the time the reply is sent.
+ *
+ *   GEN <len> <count>
+ *	Reply with <count> lines of <len> characters each, then "DONE".
+ *	The lines are sent as one large write so that the host, and
+ *	not the plugin, sets the pace.
+ *
+ * Any other line is read and discarded.
+ */
+# include  "libiseio_plug.h"
+# include  <stdio.h>
+# include  <stdlib.h>
+# include  <string.h>
+
+int main(int argc, char*argv[])
+{
+      return ise_plug_main(argc, argv);
+}
+
+static void generate(unsigned len, unsigned count)
+{
+      char*block;
+      size_t idx;
+
+      if (count == 0) {
+	    ise_plug_writeln(6, "DONE");
+	    return;
+      }
+
+	/* ise_plug_writeln adds the EOL of the last line. */
+      block = malloc((size_t)count * (len+1));
+      if (block == 0) {
+	    ise_plug_writeln(6, "DONE");
+	    return;
+      }
+
+      memset(block, 'x', (size_t)count * (len+1));
+      for (idx = 1 ;  idx < count ;  idx += 1)
+	    block[idx*(len+1) - 1] = '\n';
+      block[(size_t)count * (len+1) - 1] = 0;
+
+      ise_plug_writeln(6, block);
+      ise_plug_writeln(6, "DONE");
+      free(block);
+}
+
+void ise_plug_application(void*data, size_t ndata)
+{
+      char buf[8*1024];
+      unsigned len, count;
+
+      for (;;) {
+	    int rc = ise_plug_readln(6, buf, sizeof buf, -1);
+	    if (rc <= 0) continue;
+
+	    if (strcmp(buf, "SYNC") == 0)
+		  ise_plug_writeln(6, "DONE");
+	    else if (sscanf(buf, "GEN %u %u", &len, &count) == 2)
+		  generate(len, count);
+      }
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/*
+ * Time ise_readln at several line lengths. For each length, ask the
+ * far end to GEN enough lines to make about BENCH_BYTES bytes, and
+ * time reading them all up to the DONE.
+ *
+ * Usage: bench_readln [<device> [<firm>]]
+ */
+# include  "bench.h"
+# include  <string.h>
+
+# define BENCH_BYTES (16*1024*1024)
+
+static int time_length(struct ise_handle*dev, unsigned len)
+{
+      char cmd[64];
+      char buf[8*1024];
+      unsigned count = BENCH_BYTES / (len+1);
+      unsigned nread = 0;
+      double t_start, t_end;
+      ise_error_t rc;
+
+      snprintf(cmd, sizeof cmd, "GEN %u %u", len, count);
+
+      t_start = bench_clock();
+      rc = ise_writeln(dev, BENCH_CHANNEL, cmd);
+      while (rc == ISE_OK) {
+	    rc = ise_readln(dev, BENCH_CHANNEL, buf, sizeof buf);
+	    if (rc == ISE_OK && strcmp(buf, "DONE") == 0)
+		  break;
+	    nread += 1;
+      }
+      t_end = bench_clock();
+
+      if (rc != ISE_OK) {
+	    fprintf(stderr, "readln failed: %s\n", ise_error_msg(rc));
+	    return -1;
+      }
+      if (nread != count) {
+	    fprintf(stderr, "readln: expected %u lines, got %u\n",
+		    count, nread);
+	    return -1;
+      }
+
+      printf("line length %5u: %8u lines in %.3fs, %10.0f lines/s, "
+	     "%7.1f MB/s\n", len, count, t_end - t_start,
+	     count / (t_end - t_start),
+	     (double)count * (len+1) / (t_end - t_start) / 1e6);
+      return 0;
+}
+
+int main(int argc, char*argv[])
+{
+      static const unsigned lengths[] = { 8, 32, 128, 512, 2048 };
+      struct ise_handle*dev;
+      ise_error_t rc;
+      unsigned idx;
+
+      dev = bench_open(argc, argv);
+      if (dev == 0)
+	    return 1;
+
+      rc = ise_channel(dev, BENCH_CHANNEL);
+      if (rc != ISE_OK) {
+	    fprintf(stderr, "Unable to open channel %u: %s\n",
+		    BENCH_CHANNEL, ise_error_msg(rc));
+	    ise_close(dev);
+	    return 1;
+      }
+
+      for (idx = 0 ;  idx < sizeof lengths / sizeof lengths[0] ;  idx += 1) {
+	    if (time_length(dev, lengths[idx]) < 0)
+		  break;
+      }
+
+      ise_close(dev);
+      return 0;
+}
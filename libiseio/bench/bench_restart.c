@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/*
+ * Check that a second process gets the ise_restart fast path. Two
+ * child processes, one after the other, each ise_open_lazy the board,
+ * ise_restart it with the same firmware, and ise_close it. The first
+ * may have to load the firmware, and closes with LIBISEIO_KEEP_FIRMWARE
+ * set so that the program stays running. The second must find it
+ * still running, and closes normally, so the board is reset at the
+ * end. Each child logs to its own file, and the log of the second
+ * must say that the restart was skipped. The exit code is 0 if it
+ * does.
+ *
+ * This needs a real board and firmware that answers the heartbeat,
+ * because the plug device keeps no firmware id. Do not set LIBISEIO_FULL_RESTART when running it.
+ *
+ * Usage: bench_restart <device> <firm>
+ */
+# include  "bench.h"
+# include  <stdlib.h>
+# include  <string.h>
+# include  <unistd.h>
+# include  <sys/types.h>
+# include  <sys/wait.h>
+
+static int child_restart(char*argv[], const char*log, int keep)
+{
+      struct ise_handle*dev;
+
+	/* libiseio reads this at the first open. */
+      setenv("LIBISEIO_LOG", log, 1);
+      if (keep)
+	    setenv("LIBISEIO_KEEP_FIRMWARE", "1", 1);
+      else
+	    unsetenv("LIBISEIO_KEEP_FIRMWARE");
+
+      dev = bench_open(3, argv);
+      if (dev == 0)
+	    return 1;
+
+      ise_close(dev);
+      return 0;
+}
+
+static int run_child(char*argv[], const char*log, int keep,
+		     double*elapsed)
+{
+      double t_start = bench_clock();
+      int status;
+      pid_t pid;
+
+      fflush(stdout);
+      pid = fork();
+      if (pid < 0)
+	    return -1;
+      if (pid == 0)
+	    _exit(child_restart(argv, log, keep));
+
+      if (waitpid(pid, &status, 0) < 0)
+	    return -1;
+
+      *elapsed = bench_clock() - t_start;
+      if (! WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	    return -1;
+
+      return 0;
+}
+
+static int log_says_skipped(const char*log)
+{
+      char line[1024];
+      int found = 0;
+      FILE*fd = fopen(log, "r");
+
+      if (fd == 0)
+	    return 0;
+
+      while (fgets(line, sizeof line, fd)) {
+	    if (strstr(line, "restart skipped"))
+		  found = 1;
+      }
+
+      fclose(fd);
+      return found;
+}
+
+int main(int argc, char*argv[])
+{
+      char log1[64], log2[64];
+      double t1, t2;
+      int skipped;
+
+      if (argc < 3) {
+	    fprintf(stderr, "Usage: %s <device> <firm>\n", argv[0]);
+	    return 2;
+      }
+
+      if (getenv("LIBISEIO_FULL_RESTART")) {
+	    fprintf(stderr, "%s: LIBISEIO_FULL_RESTART is set, so there "
+		    "is no fast path to check.\n", argv[0]);
+	    return 2;
+      }
+
+      snprintf(log1, sizeof log1, "/tmp/bench_restart.%d.1", (int)getpid());
+      snprintf(log2, sizeof log2, "/tmp/bench_restart.%d.2", (int)getpid());
+
+      if (run_child(argv, log1, 1, &t1) < 0
+	  || run_child(argv, log2, 0, &t2) < 0) {
+	    fprintf(stderr, "%s: a restart failed, see %s and %s\n",
+		    argv[0], log1, log2);
+	    return 1;
+      }
+
+      skipped = log_says_skipped(log2);
+      printf("first process : %8.1fms%s\n", t1*1000.0,
+	     log_says_skipped(log1)? " (already running)" : "");
+      printf("second process: %8.1fms%s\n", t2*1000.0,
+	     skipped? " (restart skipped)" : " (FULL RESTART)");
+
+      if (! skipped) {
+	    printf("The second process did not get the fast path. "
+		   "See %s\n", log2);
+	    return 1;
+      }
+
+      unlink(log1);
+      unlink(log2);
+      return 0;
+}
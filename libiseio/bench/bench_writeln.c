@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/*
+ * Time ise_writeln against ise_writeln_batch. Each pass sends
+ * BENCH_LINES commands, then a SYNC, and waits for the DONE so that
+ * the time covers the delivery of every command and not just the
+ * queueing of it.
+ *
+ * Usage: bench_writeln [<device> [<firm>]]
+ */
+# include  "bench.h"
+# include  <stdlib.h>
+# include  <string.h>
+
+# define BENCH_LINES 100000
+
+static const char bench_text[] = "FRAME 0 EXPOSE 1000";
+
+static ise_error_t sync_channel(struct ise_handle*dev)
+{
+      char buf[64];
+      ise_error_t rc;
+
+      rc = ise_writeln(dev, BENCH_CHANNEL, "SYNC");
+      if (rc != ISE_OK)
+	    return rc;
+
+      do {
+	    rc = ise_readln(dev, BENCH_CHANNEL, buf, sizeof buf);
+      } while (rc == ISE_OK && strcmp(buf, "DONE") != 0);
+
+      return rc;
+}
+
+/*
+ * Send the lines in batches of nbatch lines. An nbatch of 0 means
+ * one ise_writeln per line.
+ */
+static int time_pass(struct ise_handle*dev, unsigned nbatch)
+{
+      const char**lines;
+      double t_start, t_end;
+      unsigned idx, sent;
+      ise_error_t rc = ISE_OK;
+
+      lines = calloc(nbatch? nbatch : 1, sizeof(const char*));
+      for (idx = 0 ;  idx < (nbatch? nbatch : 1) ;  idx += 1)
+	    lines[idx] = bench_text;
+
+      t_start = bench_clock();
+      for (sent = 0 ;  rc == ISE_OK && sent < BENCH_LINES ; ) {
+	    if (nbatch == 0) {
+		  rc = ise_writeln(dev, BENCH_CHANNEL, bench_text);
+		  sent += 1;
+	    } else {
+		  unsigned cnt = BENCH_LINES - sent;
+		  if (cnt > nbatch)
+			cnt = nbatch;
+		  rc = ise_writeln_batch(dev, BENCH_CHANNEL, lines, cnt);
+		  sent += cnt;
+	    }
+      }
+
+      if (rc == ISE_OK)
+	    rc = sync_channel(dev);
+      t_end = bench_clock();
+      free(lines);
+
+      if (rc != ISE_OK) {
+	    fprintf(stderr, "writeln failed: %s\n", ise_error_msg(rc));
+	    return -1;
+      }
+
+      if (nbatch == 0)
+	    printf("ise_writeln          : ");
+      else
+	    printf("ise_writeln_batch %4u: ", nbatch);
+      printf("%u lines in %.3fs, %.0f commands/s\n", BENCH_LINES,
+	     t_end - t_start, BENCH_LINES / (t_end - t_start));
+      return 0;
+}
+
+int main(int argc, char*argv[])
+{
+      static const unsigned batches[] = { 0, 1, 8, 64, 256 };
+      struct ise_handle*dev;
+      ise_error_t rc;
+      unsigned idx;
+
+      dev = bench_open(argc, argv);
+      if (dev == 0)
+	    return 1;
+
+      rc = ise_channel(dev, BENCH_CHANNEL);
+      if (rc != ISE_OK) {
+	    fprintf(stderr, "Unable to open channel %u: %s\n",
+		    BENCH_CHANNEL, ise_error_msg(rc));
+	    ise_close(dev);
+	    return 1;
+      }
+
+      for (idx = 0 ;  idx < sizeof batches / sizeof batches[0] ;  idx += 1) {
+	    if (time_pass(dev, batches[idx]) < 0)
+		  break;
+      }
+
+      ise_close(dev);
+      return 0;
+}
@@ -0,0 +1,445 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  <libiseio.h>
+# include  "priv.h"
+
+# include  <stdlib.h>
+# include  <unistd.h>
+# include  <string.h>
+# include  <errno.h>
+# include  <fcntl.h>
+# include  <stdint.h>
+# include  <sys/epoll.h>
+# include  <sys/eventfd.h>
+
+/*
+ * This is the asynchronous channel I/O. Each channel has a queue of
+ * pending reads and a queue of pending writes. The channel fd is put
+ * in non-blocking mode and in an epoll set for the handle, and is
+ * registered for input if there are reads pending and for output if
+ * there are writes pending. The ise_async_process function waits on
+ * the epoll set, and moves the channels that are ready along using
+ * the non-blocking driver functions.
+ *
+ * Lines that are already in the channel buffer do not make the
+ * channel fd ready, so a read that is queued while there are such
+ * lines also makes the ready eventfd of the handle readable. That
+ * way the epoll set, which is what ise_event_fd returns, polls
+ * readable whenever there is work to do.
+ */
+
+struct ise_async_op {
+      struct ise_async_op*next;
+      ise_readln_cb rd_fun;
+      ise_writeln_cb wr_fun;
+      void*cookie;
+
+	/* Writes carry the text (with the EOL) and how much of it is
+	   written so far. */
+      size_t off, len;
+      char data[0];
+};
+
+# define ASYNC_EVENTS_MAX 16
+
+static int async_epfd(struct ise_handle*dev)
+{
+      struct epoll_event ev;
+
+      if (dev->epfd >= 0)
+	    return dev->epfd;
+
+      dev->epfd = epoll_create1(EPOLL_CLOEXEC);
+      if (dev->epfd < 0) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s: epoll_create1 failed "
+			  "(errno=%d)\n", dev->id_str, errno);
+		  fflush(__ise_logfile);
+	    }
+	    return -1;
+      }
+
+	/* The ready eventfd goes in the set with a null pointer, so
+	   that it can be told from the channels. */
+      memset(&ev, 0, sizeof ev);
+      ev.events = EPOLLIN;
+      ev.data.ptr = 0;
+      dev->ready_fd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+      if (dev->ready_fd < 0
+	  || epoll_ctl(dev->epfd, EPOLL_CTL_ADD, dev->ready_fd, &ev) < 0) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s: ready eventfd failed "
+			  "(errno=%d)\n", dev->id_str, errno);
+		  fflush(__ise_logfile);
+	    }
+	    if (dev->ready_fd >= 0)
+		  close(dev->ready_fd);
+	    close(dev->epfd);
+	    dev->ready_fd = -1;
+	    dev->epfd = -1;
+      }
+
+      return dev->epfd;
+}
+
+static void async_ready_set(struct ise_handle*dev)
+{
+      uint64_t val = 1;
+      if (write(dev->ready_fd, &val, sizeof val) < 0 && __ise_logfile) {
+	    fprintf(__ise_logfile, "%s: ready eventfd write failed "
+		    "(errno=%d)\n", dev->id_str, errno);
+	    fflush(__ise_logfile);
+      }
+}
+
+static void async_ready_clear(struct ise_handle*dev)
+{
+      uint64_t val;
+      while (read(dev->ready_fd, &val, sizeof val) < 0 && errno == EINTR)
+	    ;
+}
+
+/*
+ * Make the epoll registration of the channel match its queues. A
+ * channel with nothing pending is taken out of the set so that a
+ * hangup on an idle channel does not keep waking the process.
+ */
+static ise_error_t async_arm(struct ise_handle*dev, struct ise_channel*chn)
+{
+      struct epoll_event ev;
+      int op, rc;
+      unsigned want = 0;
+
+      if (chn->rd_queue)
+	    want |= EPOLLIN;
+      if (chn->wr_queue)
+	    want |= EPOLLOUT;
+
+      if (want == chn->async_events)
+	    return ISE_OK;
+
+      if (async_epfd(dev) < 0)
+	    return ISE_ERROR;
+
+      if (! chn->async_flag) {
+	    int flags = fcntl(chn->fd, F_GETFL);
+	    if (flags < 0 || fcntl(chn->fd, F_SETFL, flags|O_NONBLOCK) < 0)
+		  return ISE_ERROR;
+	    chn->async_flag = 1;
+      }
+
+      if (want == 0)
+	    op = EPOLL_CTL_DEL;
+      else if (chn->async_events == 0)
+	    op = EPOLL_CTL_ADD;
+      else
+	    op = EPOLL_CTL_MOD;
+
+      memset(&ev, 0, sizeof ev);
+      ev.events = want;
+      ev.data.ptr = chn;
+      rc = epoll_ctl(dev->epfd, op, chn->fd, &ev);
+      if (rc < 0) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: epoll_ctl failed (errno=%d)\n",
+			  dev->id_str, chn->cid, errno);
+		  fflush(__ise_logfile);
+	    }
+	    return ISE_ERROR;
+      }
+
+      chn->async_events = want;
+      return ISE_OK;
+}
+
+static void async_append(struct ise_async_op**queue, struct ise_async_op*op)
+{
+      while (*queue)
+	    queue = &(*queue)->next;
+
+      op->next = 0;
+      *queue = op;
+}
+
+/*
+ * Fail all the pending reads of the channel with the given error.
+ */
+static unsigned async_read_fail(struct ise_handle*dev,
+				struct ise_channel*chn, ise_error_t rc)
+{
+      unsigned count = 0;
+
+      chn->line_fill = 0;
+      while (chn->rd_queue) {
+	    struct ise_async_op*op = chn->rd_queue;
+	    chn->rd_queue = op->next;
+	    op->rd_fun(dev, chn->cid, rc, "", op->cookie);
+	    free(op);
+	    count += 1;
+      }
+
+      return count;
+}
+
+/*
+ * Complete as many pending reads as there are lines available
+ * without blocking. Return the number of reads completed.
+ */
+static unsigned async_read(struct ise_handle*dev, struct ise_channel*chn)
+{
+      unsigned count = 0;
+
+      while (chn->rd_queue) {
+	    struct ise_async_op*op;
+	    const char*src;
+	    const char*nl;
+	    size_t trans;
+
+	    if (chn->fill == 0) {
+		  ise_error_t rc = dev->fun->readbuf_nb(dev, chn);
+		  if (rc == ISE_WOULD_BLOCK)
+			break;
+		  if (rc != ISE_OK) {
+			count += async_read_fail(dev, chn, rc);
+			break;
+		  }
+	    }
+
+	      /* Move text up to and including the EOL into the line
+		 that is being collected. */
+	    src = chn->buf + chn->ptr;
+	    nl = memchr(src, '\n', chn->fill);
+	    trans = nl? (nl - src + 1) : chn->fill;
+
+	    if (chn->line_fill + trans + 1 > chn->line_size) {
+		  size_t size = chn->line_size? chn->line_size : 256;
+		  while (chn->line_fill + trans + 1 > size)
+			size *= 2;
+		  chn->line = realloc(chn->line, size);
+		  chn->line_size = size;
+	    }
+
+	    memcpy(chn->line + chn->line_fill, src, trans);
+	    chn->line_fill += trans;
+	    chn->ptr  += trans;
+	    chn->fill -= trans;
+
+	    if (nl == 0)
+		  continue;
+
+	    chn->line[chn->line_fill-1] = 0;
+	    chn->line_fill = 0;
+
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: readln_async -->%s\n",
+			  dev->id_str, chn->cid, chn->line);
+		  fflush(__ise_logfile);
+	    }
+
+	      /* Take the operation off the queue before the callback,
+		 which may queue another. */
+	    op = chn->rd_queue;
+	    chn->rd_queue = op->next;
+	    op->rd_fun(dev, chn->cid, ISE_OK, chn->line, op->cookie);
+	    free(op);
+	    count += 1;
+      }
+
+      return count;
+}
+
+/*
+ * Push pending writes into the channel until it would block. A line
+ * is complete when all its text is taken. The channel is flushed
+ * only after the last pending line, so that a burst of lines shares
+ * the flush.
+ */
+static unsigned async_write(struct ise_handle*dev, struct ise_channel*chn)
+{
+      unsigned count = 0;
+
+      while (chn->wr_queue) {
+	    struct ise_async_op*op = chn->wr_queue;
+	    ise_error_t rc = ISE_OK;
+
+	    while (op->off < op->len) {
+		  size_t nput;
+		  rc = dev->fun->write_nb(dev, chn, op->data + op->off,
+					  op->len - op->off, &nput);
+		  op->off += nput;
+		  if (rc != ISE_OK)
+			break;
+	    }
+
+	    if (rc == ISE_WOULD_BLOCK)
+		  break;
+
+	    if (rc == ISE_OK && op->next == 0) {
+		  rc = dev->fun->flush_nb(dev, chn);
+		  if (rc == ISE_WOULD_BLOCK)
+			break;
+	    }
+
+	    chn->wr_queue = op->next;
+	    op->wr_fun(dev, chn->cid, rc, op->cookie);
+	    free(op);
+	    count += 1;
+      }
+
+      return count;
+}
+
+ise_error_t ise_readln_async(struct ise_handle*dev, unsigned cid,
+			     ise_readln_cb fun, void*cookie)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+      struct ise_async_op*op;
+      ise_error_t rc;
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+
+      op = calloc(1, sizeof (struct ise_async_op));
+      if (op == 0)
+	    return ISE_ERROR;
+
+      op->rd_fun = fun;
+      op->cookie = cookie;
+      async_append(&chn->rd_queue, op);
+
+      rc = async_arm(dev, chn);
+      if (rc == ISE_OK && chn->fill > 0)
+	    async_ready_set(dev);
+
+      return rc;
+}
+
+ise_error_t ise_writeln_async(struct ise_handle*dev, unsigned cid,
+			      const char*text,
+			      ise_writeln_cb fun, void*cookie)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+      struct ise_async_op*op;
+      size_t len;
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s.%u: writeln_async(%s)\n",
+		    dev->id_str, chn->cid, text);
+	    fflush(__ise_logfile);
+      }
+
+      len = strlen(text);
+      op = malloc(sizeof (struct ise_async_op) + len + 1);
+      if (op == 0)
+	    return ISE_ERROR;
+
+      op->rd_fun = 0;
+      op->wr_fun = fun;
+      op->cookie = cookie;
+      op->off = 0;
+      op->len = len + 1;
+      memcpy(op->data, text, len);
+      op->data[len] = '\n';
+      async_append(&chn->wr_queue, op);
+
+      return async_arm(dev, chn);
+}
+
+ise_error_t ise_async_process(struct ise_handle*dev, long timeout)
+{
+      struct epoll_event ev[ASYNC_EVENTS_MAX];
+      struct ise_channel*chn;
+      unsigned count = 0;
+      int idx, rc;
+
+      if (async_epfd(dev) < 0)
+	    return ISE_ERROR;
+
+	/* Lines that are already buffered do not make the fd ready,
+	   so complete them first, and then only poll the fds. This
+	   covers all the work that the ready eventfd tells of, so it
+	   can be cleared first. */
+      async_ready_clear(dev);
+      for (chn = dev->clist ;  chn ;  chn = chn->next) {
+	    if (chn->rd_queue && chn->fill > 0) {
+		  count += async_read(dev, chn);
+		  async_arm(dev, chn);
+	    }
+      }
+
+      rc = epoll_wait(dev->epfd, ev, ASYNC_EVENTS_MAX,
+		      count? 0 : (timeout < 0? -1 : (int)timeout));
+      if (rc < 0) {
+	    if (errno == EINTR)
+		  return count? ISE_OK : ISE_CHANNEL_TIMEOUT;
+	    return ISE_ERROR;
+      }
+
+      for (idx = 0 ;  idx < rc ;  idx += 1) {
+	    chn = (struct ise_channel*)ev[idx].data.ptr;
+
+	      /* The ready eventfd was set since it was cleared above.
+		 Leave it set, so the next call does that work. */
+	    if (chn == 0)
+		  continue;
+
+	    if (ev[idx].events & (EPOLLOUT|EPOLLERR|EPOLLHUP))
+		  count += async_write(dev, chn);
+	    if (ev[idx].events & (EPOLLIN|EPOLLERR|EPOLLHUP))
+		  count += async_read(dev, chn);
+
+	    async_arm(dev, chn);
+      }
+
+      return count? ISE_OK : ISE_CHANNEL_TIMEOUT;
+}
+
+int ise_event_fd(struct ise_handle*dev)
+{
+      return async_epfd(dev);
+}
+
+void __ise_async_close(struct ise_handle*dev, struct ise_channel*chn)
+{
+      if (chn->async_events && dev->epfd >= 0)
+	    epoll_ctl(dev->epfd, EPOLL_CTL_DEL, chn->fd, 0);
+      chn->async_events = 0;
+
+      while (chn->rd_queue) {
+	    struct ise_async_op*op = chn->rd_queue;
+	    chn->rd_queue = op->next;
+	    free(op);
+      }
+
+      while (chn->wr_queue) {
+	    struct ise_async_op*op = chn->wr_queue;
+	    chn->wr_queue = op->next;
+	    free(op);
+      }
+
+      free(chn->line);
+      chn->line = 0;
+      chn->line_fill = 0;
+      chn->line_size = 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  <libiseio.h>
+# include  "priv.h"
+
+# include  <stdlib.h>
+# include  <string.h>
+
+/*
+ * The frame ring keeps the frames in a circle. The frames from head
+ * (with count of them) are with the board, waiting to be filled, in
+ * the order that their fill commands were sent. The rest are held
+ * by the host. Each frame has at most one fill command outstanding,
+ * so the frame id makes a unique tag for the response.
+ */
+
+# define RING_TEXT_MAX 256
+
+struct ise_frame_ring_slot {
+      unsigned id;
+      void*base;
+      size_t size;
+      int held;
+      char tag[16];
+      char text[RING_TEXT_MAX];
+};
+
+struct ise_frame_ring {
+      struct ise_handle*dev;
+      unsigned cid;
+      char*command;
+
+	/* The fill order of the slots. order[head] is the next slot
+	   to be filled, and count slots are with the board. */
+      unsigned nslot;
+      unsigned*order;
+      unsigned head, count;
+
+      struct ise_frame_ring_slot*slot;
+};
+
+static ise_error_t ring_fill(struct ise_frame_ring*ring, unsigned idx)
+{
+      struct ise_frame_ring_slot*sp = ring->slot + idx;
+      char cmd[512];
+      ise_error_t rc;
+
+      snprintf(cmd, sizeof cmd, "%s %u", ring->command, sp->id);
+      rc = ise_request(ring->dev, ring->cid, sp->tag, cmd);
+      if (rc != ISE_OK)
+	    return rc;
+
+      sp->held = 0;
+      ring->order[(ring->head + ring->count) % ring->nslot] = idx;
+      ring->count += 1;
+      return ISE_OK;
+}
+
+struct ise_frame_ring* ise_frame_ring_open(struct ise_handle*dev,
+					   unsigned cid,
+					   unsigned first_id,
+					   unsigned nframes,
+					   size_t size,
+					   const char*command)
+{
+      struct ise_frame_ring*ring;
+      unsigned idx;
+
+      if (nframes == 0 || first_id + nframes > ISE_FRAME_MAX)
+	    return 0;
+      if (__ise_find_channel(dev, cid) == 0)
+	    return 0;
+
+      ring = calloc(1, sizeof (struct ise_frame_ring));
+      if (ring == 0)
+	    return 0;
+
+      ring->dev = dev;
+      ring->cid = cid;
+      ring->command = strdup(command);
+      ring->nslot = nframes;
+      ring->order = calloc(nframes, sizeof (unsigned));
+      ring->slot = calloc(nframes, sizeof (struct ise_frame_ring_slot));
+      if (ring->command == 0 || ring->order == 0 || ring->slot == 0)
+	    goto fail;
+
+      for (idx = 0 ;  idx < nframes ;  idx += 1) {
+	    struct ise_frame_ring_slot*sp = ring->slot + idx;
+	    sp->id = first_id + idx;
+	    sp->size = size;
+	    sp->held = 1;
+	    snprintf(sp->tag, sizeof sp->tag, "fr%u", sp->id);
+
+	    sp->base = ise_make_frame(dev, sp->id, &sp->size);
+	    if (sp->base == 0)
+		  goto fail;
+      }
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s.%u: frame ring of %u frames "
+		    "(%u-%u) of %zu bytes\n", dev->id_str, cid, nframes,
+		    first_id, first_id + nframes - 1, ring->slot[0].size);
+	    fflush(__ise_logfile);
+      }
+
+      for (idx = 0 ;  idx < nframes ;  idx += 1) {
+	    if (ring_fill(ring, idx) != ISE_OK)
+		  goto fail;
+      }
+
+      return ring;
+
+ fail:
+      ise_frame_ring_close(ring);
+      return 0;
+}
+
+ise_error_t ise_frame_ring_acquire(struct ise_frame_ring*ring,
+				   struct ise_frame_buf*buf)
+{
+      struct ise_frame_ring_slot*sp;
+      ise_error_t rc;
+
+      if (ring->count == 0)
+	    return ISE_ERROR;
+
+      sp = ring->slot + ring->order[ring->head];
+      rc = ise_response(ring->dev, ring->cid, sp->tag,
+			sp->text, sizeof sp->text);
+      if (rc != ISE_OK)
+	    return rc;
+
+      ring->head = (ring->head + 1) % ring->nslot;
+      ring->count -= 1;
+      sp->held = 1;
+
+      buf->id   = sp->id;
+      buf->base = sp->base;
+      buf->size = sp->size;
+      buf->text = sp->text;
+      return ISE_OK;
+}
+
+ise_error_t ise_frame_ring_release(struct ise_frame_ring*ring,
+				   const struct ise_frame_buf*buf)
+{
+      unsigned idx;
+
+      for (idx = 0 ;  idx < ring->nslot ;  idx += 1) {
+	    if (ring->slot[idx].id != buf->id)
+		  continue;
+	    if (! ring->slot[idx].held)
+		  return ISE_ERROR;
+
+	    return ring_fill(ring, idx);
+      }
+
+      return ISE_ERROR;
+}
+
+void ise_frame_ring_close(struct ise_frame_ring*ring)
+{
+      unsigned idx;
+
+	/* The board may still write into the frames that it has, so
+	   wait for them before deleting any frames. */
+      while (ring->count > 0) {
+	    struct ise_frame_buf buf;
+	    if (ise_frame_ring_acquire(ring, &buf) != ISE_OK)
+		  break;
+      }
+
+      if (ring->slot) {
+	    for (idx = 0 ;  idx < ring->nslot ;  idx += 1) {
+		  if (ring->slot[idx].base)
+			ise_delete_frame(ring->dev, ring->slot[idx].id);
+	    }
+      }
+
+      free(ring->slot);
+      free(ring->order);
+      free(ring->command);
+      free(ring);
+}
@@ -81,6 +81,19 @@ ise_error_t ise_send_package(struct ise_handle*dev, const char*pkg_name,
       if (ch1)
 	    return ISE_CHANNEL_BUSY;
 
+	/* The package goes to the PROM monitor. If the driver says
+	   that a program from ise_restart is running, then the board
+	   was not reset since, so reset it back to the PROM. */
+      if (dev->fun->get_firmware_id
+	  && dev->fun->get_firmware_id(dev, buf, sizeof buf) == ISE_OK
+	  && buf[0] != 0) {
+	    if (__ise_logfile)
+		  fprintf(__ise_logfile, "%s: firmware %s is running, "
+			  "reset for the package\n", dev->id_str, buf);
+
+	    dev->fun->restart(dev);
+      }
+
       ise_channel(dev, 1);
       ch1 = __ise_find_channel(dev, 1);
       if (ch1 == 0)
@@ -128,12 +141,19 @@ ise_error_t ise_send_package(struct ise_handle*dev, const char*pkg_name,
       if (status_msgs)
 	    status_msgs(buf);
 
+	/* The package may have updated the PROM, so the ident that
+	   the driver has cached may be stale. */
+      if (dev->fun->set_prom_ident)
+	    dev->fun->set_prom_ident(dev, "");
+
       assert(dev->clist == ch0);
       dev->clist = ch0->next;
+      dev->chan_map[ch0->cid] = 0;
       free(ch0);
 
       assert(dev->clist == ch1);
       dev->clist = ch1->next;
+      dev->chan_map[ch1->cid] = 0;
       free(ch1);
 
       return ISE_OK;
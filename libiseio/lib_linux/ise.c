@@ -26,6 +26,9 @@
  *    Picture Elements, Inc., 777 Panoramic Way, Berkeley, CA 94704.
  */
 
+/* The channel rings are mapped at offsets above 4G. */
+# define _FILE_OFFSET_BITS 64
+
 # include  <libiseio.h>
 # include  "priv.h"
 # include  <assert.h>
@@ -36,6 +39,8 @@
  */
 
 # include  <ucrif.h>
+# include  <linux/types.h>
+# include  <ise_tables.h>
 # include  <string.h>
 # include  <unistd.h>
 # include  <fcntl.h>
@@ -90,13 +95,93 @@ static ise_error_t restart_ise(struct ise_handle*dev)
       return ISE_OK;
 }
 
+static ise_error_t get_firmware_id_ise(struct ise_handle*dev,
+				       char*id, size_t nid)
+{
+      struct ucrx_firmware_id_s args;
+
+      if (dev->isex < 0 || nid == 0)
+	    return ISE_ERROR;
+      if (ioctl(dev->isex, UCRX_GET_FIRMWARE_ID, &args) < 0)
+	    return ISE_ERROR;
+
+      args.id[sizeof args.id - 1] = 0;
+      strncpy(id, args.id, nid);
+      id[nid-1] = 0;
+      return ISE_OK;
+}
+
+static ise_error_t set_firmware_id_ise(struct ise_handle*dev, const char*id)
+{
+      struct ucrx_firmware_id_s args;
+
+      if (dev->isex < 0)
+	    return ISE_ERROR;
+
+      memset(&args, 0, sizeof args);
+      strncpy(args.id, id, sizeof args.id - 1);
+      if (ioctl(dev->isex, UCRX_SET_FIRMWARE_ID, &args) < 0)
+	    return ISE_ERROR;
+
+      return ISE_OK;
+}
+
+static ise_error_t get_prom_ident_ise(struct ise_handle*dev, char**ident)
+{
+      struct ucrx_prom_ident_s args;
+
+      *ident = 0;
+      if (dev->isex < 0)
+	    return ISE_ERROR;
+      if (ioctl(dev->isex, UCRX_GET_PROM_IDENT, &args) < 0)
+	    return ISE_ERROR;
+
+      args.ident[sizeof args.ident - 1] = 0;
+      if (args.ident[0] != 0)
+	    *ident = strdup(args.ident);
+
+      return ISE_OK;
+}
+
+static ise_error_t set_prom_ident_ise(struct ise_handle*dev, const char*ident)
+{
+      struct ucrx_prom_ident_s args;
+
+      if (dev->isex < 0)
+	    return ISE_ERROR;
+
+	/* An ident that does not fit is not cached at all, rather
+	   than cached truncated. */
+      if (strlen(ident) >= sizeof args.ident)
+	    return ISE_ERROR;
+
+      memset(&args, 0, sizeof args);
+      strcpy(args.ident, ident);
+      if (ioctl(dev->isex, UCRX_SET_PROM_IDENT, &args) < 0)
+	    return ISE_ERROR;
+
+      return ISE_OK;
+}
+
+/*
+ * Give the board this long (in ms) to be ready to run the program.
+ */
+# define RUN_WAIT_MS 2000
+
 static ise_error_t run_program_ise(struct ise_handle*dev)
 {
       unsigned wait_count;
       int rc;
 
-      wait_count = 100;
+	/* Let the driver wait for the board to be ready. It is woken
+	   by the board, so the program starts as soon as it can. */
       do {
+	    rc = ioctl(dev->isex, UCRX_RUN_PROGRAM_WAIT, RUN_WAIT_MS);
+      } while (rc < 0 && errno == EINTR);
+
+	/* Older drivers do not have the wait, so poll instead. */
+      wait_count = rc < 0 && errno == ENOTTY? RUN_WAIT_MS/20 : 0;
+      while (wait_count > 0) {
 	      /* Run! Run! */
 	    rc = ioctl(dev->isex, UCRX_RUN_PROGRAM, 0);
 
@@ -110,7 +195,7 @@ static ise_error_t run_program_ise(struct ise_handle*dev)
 
 	    usleep(20000);
 	    wait_count -= 1;
-      } while (wait_count > 0);
+      }
 
       if (rc >= 0) {
 
@@ -134,6 +219,21 @@ static ise_error_t run_program_ise(struct ise_handle*dev)
       }
 }
 
+static ise_error_t root_batch_ise(struct ise_handle*dev, int flag)
+{
+      int rc;
+
+      if (dev->isex < 0)
+	    return ISE_ERROR;
+
+      rc = ioctl(dev->isex, UCRX_ROOT_BATCH,
+		 flag? UCRX_ROOT_BATCH_BEGIN : UCRX_ROOT_BATCH_COMMIT);
+      if (rc < 0)
+	    return ISE_ERROR;
+
+      return ISE_OK;
+}
+
 static ise_error_t channel_open_ise(struct ise_handle*dev,
 				  struct ise_channel*chn)
 {
@@ -168,19 +268,43 @@ static ise_error_t channel_sync_ise(struct ise_handle*dev,
 static ise_error_t channel_close_ise(struct ise_handle*dev,
 				     struct ise_channel*chn)
 {
+      if (chn->ring_data) {
+	    munmap(chn->ring_data, chn->ring_size);
+	    chn->ring_data = 0;
+      }
+      if (chn->ring_table) {
+	    munmap(chn->ring_table, getpagesize());
+	    chn->ring_table = 0;
+      }
+
       close(chn->fd);
       chn->fd = -1;
       return ISE_OK;
 }
 
 static ise_error_t timeout_ise(struct ise_handle*dev, unsigned cid,
-			       long read_timeout)
+			       long read_timeout_us)
 {
       int rc;
+      struct ucrx_timeout_us_s tus;
       struct ucrx_timeout_s ts;
 
+      tus.id = cid;
+      tus.read_timeout_us = read_timeout_us;
+      rc = ioctl(dev->isex, UCRX_TIMEOUT_US, &tus);
+      if (rc >= 0)
+	    return ISE_OK;
+      if (errno != ENOTTY)
+	    return ISE_ERROR;
+
+	/* Older drivers only take milliseconds. Round up, so that a
+	   short timeout does not become a polling read. */
       ts.id = cid;
-      ts.read_timeout = read_timeout;
+      if (read_timeout_us > 0)
+	    ts.read_timeout = read_timeout_us / 1000
+		  + (read_timeout_us % 1000? 1 : 0);
+      else
+	    ts.read_timeout = read_timeout_us;
       rc = ioctl(dev->isex, UCRX_TIMEOUT, &ts);
       if (rc < 0)
 	    return ISE_ERROR;
@@ -188,21 +312,326 @@ static ise_error_t timeout_ise(struct ise_handle*dev, unsigned cid,
       return ISE_OK;
 }
 
+static ise_error_t channel_ring_ise(struct ise_handle*dev,
+				    struct ise_channel*chn,
+				    unsigned*depth, size_t*buf_size)
+{
+      int rc;
+      struct ucr_channel_ring_s ring;
+
+      ring.depth = *depth;
+      ring.buf_size = *buf_size;
+      rc = ioctl(chn->fd, UCR_CHANNEL_RING, &ring);
+      if (rc < 0) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: UCR_CHANNEL_RING error %d\n",
+			  dev->id_str, chn->cid, errno);
+		  fflush(__ise_logfile);
+	    }
+	    return errno == EBUSY? ISE_CHANNEL_BUSY : ISE_ERROR;
+      }
+
+      *depth = ring.depth;
+      *buf_size = ring.buf_size;
+      return ISE_OK;
+}
+
+/*
+ * Map the ring table and ring buffers of the channel, if they are not
+ * mapped already. The driver only allows this for channels that have
+ * a ring table.
+ */
+static ise_error_t ring_map_ise(struct ise_handle*dev, struct ise_channel*chn)
+{
+      const volatile struct channel_table2*tab;
+      void*base;
+
+      if (chn->ring_data)
+	    return ISE_OK;
+
+      base = mmap(0, getpagesize(), PROT_READ, MAP_SHARED,
+		  chn->fd, UCR_RING_MMAP_TABLE);
+      if (base == MAP_FAILED) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: map ring table error %d\n",
+			  dev->id_str, chn->cid, errno);
+		  fflush(__ise_logfile);
+	    }
+	    return ISE_ERROR;
+      }
+
+      chn->ring_table = base;
+      tab = (const volatile struct channel_table2*)base;
+      chn->ring_size = (size_t)(tab->obufs + tab->ibufs) * tab->buf_size;
+
+      base = mmap(0, chn->ring_size, PROT_READ|PROT_WRITE, MAP_SHARED,
+		  chn->fd, UCR_RING_MMAP_DATA);
+      if (base == MAP_FAILED) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: map ring data error %d\n",
+			  dev->id_str, chn->cid, errno);
+		  fflush(__ise_logfile);
+	    }
+	    munmap(chn->ring_table, getpagesize());
+	    chn->ring_table = 0;
+	    return ISE_ERROR;
+      }
+
+      chn->ring_data = base;
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s.%u: mapped ring of %u/%u buffers "
+		    "of %u bytes\n", dev->id_str, chn->cid,
+		    tab->obufs, tab->ibufs, tab->buf_size);
+	    fflush(__ise_logfile);
+      }
+
+      return ISE_OK;
+}
+
+static ise_error_t ring_out_buffer_ise(struct ise_handle*dev,
+				       struct ise_channel*chn,
+				       void**buf, size_t*nbuf)
+{
+      const volatile struct channel_table2*tab;
+      ise_error_t rc;
+
+      rc = ring_map_ise(dev, chn);
+      if (rc != ISE_OK)
+	    return rc;
+
+	/* The buffer at next_out_idx always belongs to the host, even
+	   when the ring is full, so it can be filled right away. */
+      tab = (const volatile struct channel_table2*)chn->ring_table;
+      *buf = (char*)chn->ring_data + tab->next_out_idx * tab->buf_size;
+      *nbuf = tab->buf_size;
+      return ISE_OK;
+}
+
+static ise_error_t ring_out_publish_ise(struct ise_handle*dev,
+					struct ise_channel*chn,
+					size_t count)
+{
+      int rc = ioctl(chn->fd, UCR_RING_PRODUCE, count);
+      if (rc < 0) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: UCR_RING_PRODUCE error %d\n",
+			  dev->id_str, chn->cid, errno);
+		  fflush(__ise_logfile);
+	    }
+	    return ISE_ERROR;
+      }
+
+      return ISE_OK;
+}
+
+static ise_error_t ring_in_buffer_ise(struct ise_handle*dev,
+				      struct ise_channel*chn,
+				      const void**buf, size_t*count)
+{
+      const volatile struct channel_table2*tab;
+      unsigned idx;
+      ise_error_t rc;
+      int ready;
+
+      rc = ring_map_ise(dev, chn);
+      if (rc != ISE_OK)
+	    return rc;
+
+      ready = ioctl(chn->fd, UCR_RING_WAIT, 0);
+      if (ready < 0) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: UCR_RING_WAIT error %d\n",
+			  dev->id_str, chn->cid, errno);
+		  fflush(__ise_logfile);
+	    }
+	    return ISE_ERROR;
+      }
+
+      if (ready == 0)
+	    return ISE_CHANNEL_TIMEOUT;
+
+      tab = (const volatile struct channel_table2*)chn->ring_table;
+      idx = tab->obufs + tab->first_in_idx;
+      *buf = (const char*)chn->ring_data + idx * tab->buf_size;
+      *count = tab->buf[idx].count;
+      return ISE_OK;
+}
+
+static ise_error_t ring_in_release_ise(struct ise_handle*dev,
+				       struct ise_channel*chn)
+{
+      int rc = ioctl(chn->fd, UCR_RING_CONSUME, 1);
+      if (rc < 0) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: UCR_RING_CONSUME error %d\n",
+			  dev->id_str, chn->cid, errno);
+		  fflush(__ise_logfile);
+	    }
+	    return ISE_ERROR;
+      }
+
+      return ISE_OK;
+}
+
+/*
+ * Frames 0-15 are made the old way, which works with any driver, and
+ * frames past that need UCR_MAKE_FRAME64 and are mapped at a
+ * different offset.
+ */
 static ise_error_t make_frame_ise(struct ise_handle*dev, unsigned id)
 {
       size_t siz = dev->frame[id].size;
-      unsigned long arg = (id << 28) | (siz & 0x0fffffffUL);
+      off_t off;
       int rc;
 
-      rc = ioctl(dev->clist->fd, UCR_MAKE_FRAME, arg);
-      if (rc < 0) {
+      if (id < 16) {
+	    unsigned long arg = (id << 28) | (siz & 0x0fffffffUL);
+	    rc = ioctl(dev->clist->fd, UCR_MAKE_FRAME, arg);
+	    if (rc < 0) {
+		  dev->frame[id].base = 0;
+		  return ISE_ERROR;
+	    }
+
+	    dev->frame[id].size = rc;
+	    off = id << 28;
+
+      } else {
+	    struct ucr_frame64_s arg;
+	    arg.id = id;
+	    arg.reserved = 0;
+	    arg.size = siz;
+	    rc = ioctl(dev->clist->fd, UCR_MAKE_FRAME64, &arg);
+	    if (rc < 0) {
+		  if (__ise_logfile) {
+			fprintf(__ise_logfile, "%s: make frame %u failed "
+				"(errno=%d)\n", dev->id_str, id, errno);
+			fflush(__ise_logfile);
+		  }
+		  dev->frame[id].base = 0;
+		  return ISE_ERROR;
+	    }
+
+	    dev->frame[id].size = arg.size;
+	    off = UCR_FRAME64_MMAP(id);
+      }
+
+	/* The prefault flag must be set before the mmap. An older
+	   driver does not know it, and will fault in pages anyhow. */
+      if (dev->frame[id].prefault) {
+	    rc = ioctl(dev->clist->fd, UCR_FRAME_PREFAULT, (id << 8) | 1);
+	    if (rc < 0 && __ise_logfile) {
+		  fprintf(__ise_logfile, "%s: frame %u prefault not "
+			  "supported (errno=%d)\n", dev->id_str, id, errno);
+		  fflush(__ise_logfile);
+	    }
+      }
+
+      dev->frame[id].base = mmap(0, siz, PROT_READ|PROT_WRITE,
+				 MAP_SHARED, dev->clist->fd, off);
+      if (dev->frame[id].base == MAP_FAILED) {
 	    dev->frame[id].base = 0;
 	    return ISE_ERROR;
       }
 
-      dev->frame[id].size = rc;
-      dev->frame[id].base = mmap(0, siz, PROT_READ|PROT_WRITE,
-				 MAP_SHARED, dev->clist->fd, (id << 28));
+      return ISE_OK;
+}
+
+static long frame_faults_ise(struct ise_handle*dev, unsigned id)
+{
+      int rc;
+
+      assert(dev->clist);
+      rc = ioctl(dev->clist->fd, UCR_FRAME_FAULTS, id);
+      if (rc < 0)
+	    return -1;
+
+      return rc;
+}
+
+/*
+ * The heartbeat needs only the control device, so a handle from
+ * ise_bind, which has none, opens it here. That does not disturb
+ * the process that owns the board.
+ */
+static ise_error_t heartbeat_ise(struct ise_handle*dev, unsigned timeout_ms,
+				 unsigned*status)
+{
+      struct ucrx_heartbeat_s args;
+      int rc;
+
+      if (dev->isex < 0 && connect_ise(dev) != ISE_OK)
+	    return ISE_ERROR;
+
+      memset(&args, 0, sizeof args);
+      args.timeout = timeout_ms;
+      do {
+	    rc = ioctl(dev->isex, UCRX_HEARTBEAT, &args);
+      } while (rc < 0 && errno == EINTR);
+
+      if (rc < 0 && errno != ETIMEDOUT)
+	    return ISE_ERROR;
+
+      *status = args.status;
+      if (args.flags & UCRX_HEARTBEAT_BOOTPROM)
+	    return ISE_OK;
+      if (args.flags & UCRX_HEARTBEAT_ANSWERED)
+	    return ISE_OK;
+
+      return ISE_CHANNEL_TIMEOUT;
+}
+
+/*
+ * Frame events come through the control device. They are read from
+ * a second open of it that is in non-blocking mode, so that reading
+ * only collects events that the application has already polled for.
+ * The isex used for everything else stays blocking.
+ */
+static int frame_event_fd_ise(struct ise_handle*dev)
+{
+      char pathx[16];
+
+      if (dev->isex < 0)
+	    return -1;
+
+      if (ioctl(dev->isex, UCRX_FRAME_EVENTS, 1) < 0) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s: frame events not available "
+			  "(errno=%d)\n", dev->id_str, errno);
+		  fflush(__ise_logfile);
+	    }
+	    return -1;
+      }
+
+      if (dev->event_fd < 0) {
+	    sprintf(pathx, "/dev/isex%u", get_board_id(dev));
+	    dev->event_fd = open(pathx, O_RDWR|O_NONBLOCK, 0);
+      }
+
+      return dev->event_fd;
+}
+
+static ise_error_t frame_event_read_ise(struct ise_handle*dev,
+					unsigned*done_seq, unsigned nframes)
+{
+      __u32 seq[FRAME_EVENT_FRAMES];
+      unsigned idx;
+      ssize_t rc;
+
+      if (nframes > FRAME_EVENT_FRAMES)
+	    nframes = FRAME_EVENT_FRAMES;
+
+      if (dev->event_fd < 0)
+	    return ISE_ERROR;
+
+      rc = read(dev->event_fd, seq, nframes * sizeof seq[0]);
+      if (rc < 0 && errno == EAGAIN)
+	    return ISE_WOULD_BLOCK;
+      if (rc < 0)
+	    return ISE_ERROR;
+
+      for (idx = 0 ;  idx < nframes && idx < rc/sizeof seq[0] ;  idx += 1)
+	    done_seq[idx] = seq[idx];
 
       return ISE_OK;
 }
@@ -216,7 +645,10 @@ static void delete_frame_ise(struct ise_handle*dev, unsigned id)
       dev->frame[id].base = 0;
 
       assert(dev->clist);   
-      rc = ioctl(dev->clist->fd, UCR_FREE_FRAME, arg);
+      if (id < 16)
+	    rc = ioctl(dev->clist->fd, UCR_FREE_FRAME, arg);
+      else
+	    rc = ioctl(dev->clist->fd, UCR_FREE_FRAME64, id);
       if (rc < 0)
 	    fprintf(stderr, "UCR_FREE_FRAME error %d\n", errno);
 }
@@ -229,16 +661,39 @@ static ise_error_t write_ise(struct ise_handle*dev,
       return ISE_OK;
 }
 
+static ise_error_t writev_ise(struct ise_handle*dev,
+			      struct ise_channel*chn,
+			      struct iovec*iov, int iovcnt)
+{
+      int rc;
+
+      if (__ise_writev_all(chn->fd, iov, iovcnt) < 0) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: writev error (errno=%d)\n",
+			  dev->id_str, chn->cid, errno);
+		  fflush(__ise_logfile);
+	    }
+	    return ISE_ERROR;
+      }
+
+      rc = ioctl(chn->fd, UCR_FLUSH, 0);
+      if (rc < 0)
+	    return ISE_ERROR;
+
+      return ISE_OK;
+}
+
 static ise_error_t writeln_ise(struct ise_handle*dev,
 			       struct ise_channel*chn,
 			       const char*text)
 {
-      int rc;
-      char nl;
+      struct iovec iov[2];
 
-      rc = write(chn->fd, text, strlen(text));
-      nl = '\n';
-      rc = write(chn->fd, &nl, 1);
+	/* Write the text and EOL together, then flush. */
+      iov[0].iov_base = (void*)text;
+      iov[0].iov_len  = strlen(text);
+      iov[1].iov_base = "\n";
+      iov[1].iov_len  = 1;
 
       if (__ise_logfile) {
 	    fprintf(__ise_logfile, "%s.%u: writeln FLUSH\n",
@@ -246,9 +701,7 @@ static ise_error_t writeln_ise(struct ise_handle*dev,
 	    fflush(__ise_logfile);
       }
 
-      rc = ioctl(chn->fd, UCR_FLUSH, 0);
-
-      return ISE_OK;
+      return writev_ise(dev, chn, iov, 2);
 }
 
 static ise_error_t readbuf_ise(struct ise_handle*dev,
@@ -256,7 +709,9 @@ static ise_error_t readbuf_ise(struct ise_handle*dev,
 {
       int rc;
 
-      rc = read(chn->fd, chn->buf, sizeof chn->buf);
+      __ise_compact(chn);
+      rc = read(chn->fd, chn->buf + chn->fill,
+		sizeof chn->buf - chn->fill);
 
       if (__ise_logfile) {
 	    fprintf(__ise_logfile, "%s.%u: read returned (%d)...\n",
@@ -274,8 +729,78 @@ static ise_error_t readbuf_ise(struct ise_handle*dev,
 	    return ISE_ERROR;
       }
 
-      chn->ptr = 0;
-      chn->fill = rc;
+      chn->fill += rc;
+      return ISE_OK;
+}
+
+/*
+ * The non-blocking functions are used by the asynchronous I/O, which
+ * sets O_NONBLOCK on the channel fd. The driver then returns EAGAIN
+ * from writes and flushes that find the ring full, and 0 from reads
+ * that find no data.
+ */
+static ise_error_t write_nb_ise(struct ise_handle*dev,
+				struct ise_channel*chn,
+				const void*buf, size_t nbuf, size_t*nput)
+{
+      ssize_t rc = write(chn->fd, buf, nbuf);
+
+      if (rc < 0) {
+	    *nput = 0;
+	    if (errno == EAGAIN)
+		  return ISE_WOULD_BLOCK;
+
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: write error (errno=%d)\n",
+			  dev->id_str, chn->cid, errno);
+		  fflush(__ise_logfile);
+	    }
+	    return ISE_ERROR;
+      }
+
+      *nput = rc;
+      return ISE_OK;
+}
+
+static ise_error_t flush_nb_ise(struct ise_handle*dev,
+				struct ise_channel*chn)
+{
+      int rc = ioctl(chn->fd, UCR_FLUSH, 0);
+
+      if (rc < 0) {
+	    if (errno == EAGAIN)
+		  return ISE_WOULD_BLOCK;
+
+	    return ISE_ERROR;
+      }
+
+      return ISE_OK;
+}
+
+static ise_error_t readbuf_nb_ise(struct ise_handle*dev,
+				  struct ise_channel*chn)
+{
+      int rc;
+
+      __ise_compact(chn);
+      rc = read(chn->fd, chn->buf + chn->fill,
+		sizeof chn->buf - chn->fill);
+      if (rc == 0)
+	    return ISE_WOULD_BLOCK;
+
+      if (rc < 0) {
+	    if (errno == EAGAIN)
+		  return ISE_WOULD_BLOCK;
+
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: read error (errno=%d)\n",
+			  dev->id_str, chn->cid, errno);
+		  fflush(__ise_logfile);
+	    }
+	    return ISE_ERROR;
+      }
+
+      chn->fill += rc;
       return ISE_OK;
 }
 
@@ -285,16 +810,35 @@ const struct ise_driver_functions __driver_ise = {
  connect: connect_ise,
  restart: restart_ise,
  run_program: run_program_ise,
+ get_firmware_id: get_firmware_id_ise,
+ set_firmware_id: set_firmware_id_ise,
+ get_prom_ident: get_prom_ident_ise,
+ set_prom_ident: set_prom_ident_ise,
 
+ root_batch: root_batch_ise,
  channel_open: channel_open_ise,
  channel_close: channel_close_ise,
  channel_sync: channel_sync_ise,
  timeout: timeout_ise,
+ channel_ring: channel_ring_ise,
+ ring_out_buffer: ring_out_buffer_ise,
+ ring_out_publish: ring_out_publish_ise,
+ ring_in_buffer: ring_in_buffer_ise,
+ ring_in_release: ring_in_release_ise,
 
  make_frame:  make_frame_ise,
  delete_frame: delete_frame_ise,
+ frame_faults: frame_faults_ise,
+ frame_event_fd: frame_event_fd_ise,
+ frame_event_read: frame_event_read_ise,
+ heartbeat: heartbeat_ise,
 
  write: write_ise,
+ writev: writev_ise,
  writeln: writeln_ise,
  readbuf: readbuf_ise,
+
+ write_nb: write_nb_ise,
+ flush_nb: flush_nb_ise,
+ readbuf_nb: readbuf_nb_ise,
 };
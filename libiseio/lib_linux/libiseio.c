@@ -35,9 +35,18 @@
 # include  <string.h>
 # include  <errno.h>
 # include  <fcntl.h>
+# include  <limits.h>
+# include  <stdint.h>
+# include  <time.h>
+# include  <sys/mman.h>
+# include  <sys/stat.h>
 
 # include  <assert.h>
 
+#ifndef IOV_MAX
+# define IOV_MAX 1024
+#endif
+
 #ifndef FIRM_ROOT
 # define FIRM_ROOT "/usr/share/ise"
 #endif
@@ -46,12 +55,48 @@ FILE*__ise_logfile = 0;
 
 struct ise_channel* __ise_find_channel(struct ise_handle*dev, unsigned cid)
 {
-      struct ise_channel*chn = dev->clist;
+      if (cid >= ISE_CHANNEL_MAX)
+	    return 0;
+
+      return dev->chan_map[cid];
+}
+
+void __ise_compact(struct ise_channel*chn)
+{
+      if (chn->ptr == 0)
+	    return;
 
-      while (chn && chn->cid != cid)
-	    chn = chn->next;
+      if (chn->fill > 0)
+	    memmove(chn->buf, chn->buf + chn->ptr, chn->fill);
 
-      return chn;
+      chn->ptr = 0;
+}
+
+int __ise_writev_all(int fd, struct iovec*iov, int iovcnt)
+{
+      while (iovcnt > 0) {
+	    ssize_t rc = writev(fd, iov, iovcnt < IOV_MAX? iovcnt : IOV_MAX);
+	    if (rc < 0) {
+		  if (errno == EINTR)
+			continue;
+		  return -1;
+	    }
+
+	      /* Skip the segments that are completely written, and
+		 trim the one that is partly written. */
+	    while (iovcnt > 0 && (size_t)rc >= iov->iov_len) {
+		  rc -= iov->iov_len;
+		  iov += 1;
+		  iovcnt -= 1;
+	    }
+
+	    if (iovcnt > 0) {
+		  iov->iov_base = (char*)iov->iov_base + rc;
+		  iov->iov_len -= rc;
+	    }
+      }
+
+      return 0;
 }
 
 const char*ise_error_msg(ise_error_t code)
@@ -67,6 +112,10 @@ const char*ise_error_msg(ise_error_t code)
 	    return "no such open channel";
 	  case ISE_CHANNEL_BUSY:
 	    return "channel is busy or locked";
+	  case ISE_CHANNEL_TIMEOUT:
+	    return "channel read timed out";
+	  case ISE_WOULD_BLOCK:
+	    return "operation would block";
 
 	  default:
 	    return "unknown ise error code";
@@ -78,11 +127,214 @@ const char*ise_prom_version(struct ise_handle*dev)
       return dev->version;
 }
 
+/*
+ * The firmware is sent to channel 0 in chunks this large, and the
+ * channel ring is asked for buffers of this size.
+ */
+# define FIRM_CHUNK (256*1024)
+# define FIRM_RING_DEPTH 8
+
+/*
+ * A program that ise_restart finds already running must answer a
+ * heartbeat within this many milliseconds, or it is restarted.
+ */
+# define FIRM_ALIVE_MS 200
+
+static double firm_clock(void)
+{
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Send the firmware image through the mapped ring of channel 0, so
+ * that each chunk is copied once, straight from the file mapping into
+ * the channel buffer. The *nsent is the number of bytes sent. If the
+ * driver or the bootprom cannot do rings, this returns an error
+ * before anything is sent, and the caller falls back on plain writes
+ * from *nsent.
+ */
+static ise_error_t firm_send_ring(struct ise_handle*dev,
+				  struct ise_channel*ch0,
+				  const char*data, size_t ndata,
+				  size_t*nsent)
+{
+      unsigned depth = FIRM_RING_DEPTH;
+      size_t buf_size = FIRM_CHUNK;
+      void*buf;
+      size_t nbuf, off;
+      ise_error_t rc;
+
+      *nsent = 0;
+
+      if (dev->fun->channel_ring == 0 || dev->fun->ring_out_buffer == 0
+	  || dev->fun->ring_out_publish == 0)
+	    return ISE_ERROR;
+
+      rc = dev->fun->channel_ring(dev, ch0, &depth, &buf_size);
+      if (rc != ISE_OK)
+	    return rc;
+
+	/* Mapping the ring fails if the bootprom did not take the
+	   ring table. */
+      rc = dev->fun->ring_out_buffer(dev, ch0, &buf, &nbuf);
+      if (rc != ISE_OK)
+	    return rc;
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s: firmware through ring of %u "
+		    "buffers of %zu bytes\n", dev->id_str, depth, nbuf);
+	    fflush(__ise_logfile);
+      }
+
+      for (off = 0 ;  off < ndata ;  off += nbuf) {
+	    if (off > 0) {
+		  rc = dev->fun->ring_out_buffer(dev, ch0, &buf, &nbuf);
+		  if (rc != ISE_OK)
+			return rc;
+	    }
+
+	    if (nbuf > ndata - off)
+		  nbuf = ndata - off;
+	    memcpy(buf, data + off, nbuf);
+
+	    rc = dev->fun->ring_out_publish(dev, ch0, nbuf);
+	    if (rc != ISE_OK)
+		  return rc;
+
+	    *nsent = off + nbuf;
+      }
+
+      return ISE_OK;
+}
+
+/*
+ * The firmware id that the driver keeps for the board is the FNV-1a
+ * hash and size of the SCOF image, then the base name of the
+ * firmware. This is cheap next to sending the image, and tells when
+ * the same image is already running. The hash and size come first,
+ * so that if a long name is cut short by the size of the id, only
+ * the name is cut.
+ */
+static void firm_make_id(char*id, size_t nid, const char*firm,
+			 const char*data, size_t ndata)
+{
+      unsigned long long hash = 0xcbf29ce484222325ULL;
+      const char*base = strrchr(firm, '/');
+      size_t idx;
+
+      for (idx = 0 ;  idx < ndata ;  idx += 1) {
+	    hash ^= (unsigned char)data[idx];
+	    hash *= 0x100000001b3ULL;
+      }
+
+      snprintf(id, nid, "%016llx:%zu:%s", hash, ndata, base? base+1 : firm);
+}
+
+/*
+ * Get the id of the firmware that the driver says the board is
+ * running. This is true only if a program loaded by ise_restart is
+ * running, and the board was not reset since. ise_open_lazy leaves
+ * such a board running, and so does ise_close if LIBISEIO_KEEP_FIRMWARE
+ * is set in the environment, so that the next ise_restart of the same
+ * image, even from another process, can skip the reset and download.
+ * With LIBISEIO_FULL_RESTART set in the environment, this is always
+ * false, so the board is always reset.
+ */
+static int firm_running(struct ise_handle*dev, char*id, size_t nid)
+{
+      if (dev->fun->get_firmware_id == 0)
+	    return 0;
+      if (getenv("LIBISEIO_FULL_RESTART"))
+	    return 0;
+      if (dev->fun->get_firmware_id(dev, id, nid) != ISE_OK)
+	    return 0;
+
+      return id[0] != 0;
+}
+
+/*
+ * Close all the frames and channels of the handle. ise_close uses
+ * this, and so does ise_restart when it skips the reset.
+ */
+static void close_frames_and_channels(struct ise_handle*dev)
+{
+      unsigned idx;
+
+      for (idx = 0 ;  idx < ISE_FRAME_MAX ;  idx += 1) {
+	    if (dev->frame[idx].base == 0)
+		  continue;
+
+	    if (__ise_logfile)
+		  fprintf(__ise_logfile, "%s: delete frame %u\n",
+			  dev->id_str, idx);
+
+	    ise_delete_frame(dev, idx);
+      }
+
+      while (dev->clist) {
+	    struct ise_channel*chn = dev->clist;
+	    dev->clist = chn->next;
+	    dev->chan_map[chn->cid] = 0;
+
+	    if (__ise_logfile)
+		  fprintf(__ise_logfile, "%s: Close channel %u\n",
+			  dev->id_str, chn->cid);
+
+	    __ise_async_close(dev, chn);
+	    __ise_stash_clear(chn);
+	    dev->fun->channel_close(dev, chn);
+	    free(chn->msg);
+	    free(chn);
+      }
+}
+
+/*
+ * Bring a program that is already running back to the state it is in
+ * right after a download, so that ise_restart can skip the download.
+ * A reset would take away all the frames and channels of the handle,
+ * so close them. Then make sure with a heartbeat that the program is
+ * still alive, and that the board did not fall back to the bootprom
+ * some way that the driver did not notice. If this fails, then
+ * ise_restart does the full reset and download after all.
+ */
+static ise_error_t firm_reinit(struct ise_handle*dev)
+{
+      unsigned status = 0;
+      ise_error_t rc;
+
+      close_frames_and_channels(dev);
+
+      if (dev->fun->heartbeat == 0)
+	    return ISE_ERROR;
+
+      rc = dev->fun->heartbeat(dev, FIRM_ALIVE_MS, &status);
+      if (rc == ISE_OK && (status & 0x0001))
+	    rc = ISE_ERROR;
+
+      if (rc != ISE_OK && __ise_logfile) {
+	    fprintf(__ise_logfile, "%s: running firmware does not answer "
+		    "(%s, status=0x%04x), full restart\n", dev->id_str,
+		    ise_error_msg(rc), status);
+	    fflush(__ise_logfile);
+      }
+
+      return rc;
+}
+
 ise_error_t ise_restart(struct ise_handle*dev, const char*firm)
 {
       char path[4096];
-      int fd, rc;
+      char firm_id[128];
+      char cur_id[128];
+      int fd;
       ise_error_t rc_ise;
+      struct stat sb;
+      char*data;
+      size_t ndata, nsent, off;
+      int map_flag;
+      double t_start, t_read, t_open, t_send, t_sync, t_run;
 
       struct ise_channel ch0;
 
@@ -90,22 +342,7 @@ ise_error_t ise_restart(struct ise_handle*dev, const char*firm)
 	    fprintf(__ise_logfile, "%s: **** ise_restart(...,%s)\n",
 		    dev->id_str, firm);
 
-      dev->fun->restart(dev);
-      
-	/* Open channel 0 to the firmware. This will be where I shove
-	   the firmware. */
-
-      if (__ise_logfile)
-	    fprintf(__ise_logfile, "%s: open channel 0\n", dev->id_str);
-
-      ch0.next = 0;
-      ch0.cid  = 0;
-      ch0.fd   = -1;
-      ch0.ptr  = 0;
-      ch0.fill = 0;
-      rc_ise = dev->fun->channel_open(dev, &ch0);
-      if (rc_ise != ISE_OK)
-	    return rc_ise;
+      t_start = firm_clock();
 
 	/* Try to find the scof file. Look in the current working
 	   directory and the compiled in library directory. */
@@ -131,24 +368,145 @@ ise_error_t ise_restart(struct ise_handle*dev, const char*firm)
 		  fprintf(__ise_logfile, "%s: **** No firmware, "
 			  "giving up.\n", dev->id_str, path);
 
-	    dev->fun->channel_close(dev, &ch0);
 	    return ISE_NO_SCOF;
       }
 
-      if (__ise_logfile)
-	    fprintf(__ise_logfile, "%s: transmitting firmware\n", dev->id_str);
+	/* Map the whole SCOF file. If it cannot be mapped (for
+	   example it is a pipe) then read it all into memory. */
+      map_flag = 0;
+      data = 0;
+      ndata = 0;
+      if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+	    ndata = sb.st_size;
+	    data = mmap(0, ndata, PROT_READ, MAP_PRIVATE, fd, 0);
+	    if (data == MAP_FAILED) {
+		  data = 0;
+	    } else {
+		  map_flag = 1;
+		  madvise(data, ndata, MADV_SEQUENTIAL);
+		  madvise(data, ndata, MADV_WILLNEED);
+	    }
+      }
 
-	/* In a loop, read bytes of the SCOF file and write them into
-	   channel 0. This causes the flash to load the firmware into
-	   DRAM at the correct places. */
-      rc = read(fd, path, sizeof path);
-      while (rc > 0) {
-	    dev->fun->write(dev, &ch0, path, rc);
-	    rc = read(fd, path, sizeof path);
+      if (data == 0) {
+	    size_t size = FIRM_CHUNK;
+	    ssize_t rc;
+	    ndata = 0;
+	    data = malloc(size);
+	    while (data && (rc = read(fd, data+ndata, size-ndata)) > 0) {
+		  ndata += rc;
+		  if (ndata == size) {
+			char*tmp = realloc(data, size*2);
+			if (tmp == 0)
+			      free(data);
+			data = tmp;
+			size *= 2;
+		  }
+	    }
       }
 
       close(fd);
 
+      if (data == 0) {
+	    if (__ise_logfile)
+		  fprintf(__ise_logfile, "%s: **** Unable to read "
+			  "firmware %s\n", dev->id_str, path);
+
+	    return ISE_NO_SCOF;
+      }
+
+      firm_make_id(firm_id, sizeof firm_id, firm, data, ndata);
+      t_read = firm_clock();
+
+	/* If the board is already running this very image, and the
+	   program is alive, then there is no need to reset it and send
+	   the image again. The driver forgets the id whenever the board
+	   is reset. */
+      if (firm_running(dev, cur_id, sizeof cur_id)
+	  && strcmp(cur_id, firm_id) == 0
+	  && firm_reinit(dev) == ISE_OK) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s: firmware %s already "
+			  "running, restart skipped (%.1fms)\n",
+			  dev->id_str, firm_id,
+			  (t_read-t_start)*1000.0);
+		  fflush(__ise_logfile);
+	    }
+
+	    if (map_flag)
+		  munmap(data, ndata);
+	    else
+		  free(data);
+	    return ISE_OK;
+      }
+
+      dev->fun->restart(dev);
+      
+	/* Open channel 0 to the firmware. This will be where I shove
+	   the firmware. */
+
+      if (__ise_logfile)
+	    fprintf(__ise_logfile, "%s: open channel 0\n", dev->id_str);
+
+      memset(&ch0, 0, sizeof ch0);
+      ch0.next = 0;
+      ch0.cid  = 0;
+      ch0.fd   = -1;
+      ch0.ptr  = 0;
+      ch0.fill = 0;
+      ch0.ring_table = 0;
+      ch0.ring_data  = 0;
+      rc_ise = dev->fun->channel_open(dev, &ch0);
+      if (rc_ise != ISE_OK) {
+	    if (map_flag)
+		  munmap(data, ndata);
+	    else
+		  free(data);
+	    return rc_ise;
+      }
+
+      t_open = firm_clock();
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s: transmitting firmware (%zu bytes)\n",
+		    dev->id_str, ndata);
+	    fflush(__ise_logfile);
+      }
+
+	/* Write the bytes of the SCOF file into channel 0. This
+	   causes the flash to load the firmware into DRAM at the
+	   correct places. Use the channel ring if possible, or write
+	   large chunks otherwise. */
+      rc_ise = ISE_OK;
+      if (firm_send_ring(dev, &ch0, data, ndata, &nsent) != ISE_OK) {
+	    for (off = nsent ;  off < ndata ;  off += FIRM_CHUNK) {
+		  size_t trans = ndata - off;
+		  if (trans > FIRM_CHUNK)
+			trans = FIRM_CHUNK;
+		  rc_ise = dev->fun->write(dev, &ch0, data + off, trans);
+		  if (rc_ise != ISE_OK)
+			break;
+	    }
+      }
+
+      if (map_flag)
+	    munmap(data, ndata);
+      else
+	    free(data);
+
+      if (rc_ise != ISE_OK) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s: **** firmware write failed "
+			  "at offset %zu: %s\n", dev->id_str, off,
+			  ise_error_msg(rc_ise));
+		  fflush(__ise_logfile);
+	    }
+	    dev->fun->channel_close(dev, &ch0);
+	    return rc_ise;
+      }
+
+      t_send = firm_clock();
+
       if (__ise_logfile) {
 	    fprintf(__ise_logfile, "%s: sync channel 0...\n", dev->id_str);
 	    fflush(__ise_logfile);
@@ -160,13 +518,33 @@ ise_error_t ise_restart(struct ise_handle*dev, const char*firm)
 	   before the channel buffers are removed by the close. */
       dev->fun->channel_sync(dev, &ch0);
       dev->fun->channel_close(dev, &ch0);
+      t_sync = firm_clock();
 
       if (__ise_logfile) {
 	    fprintf(__ise_logfile, "%s: running program\n", dev->id_str);
 	    fflush(__ise_logfile);
       }
 
-      return dev->fun->run_program(dev);
+      rc_ise = dev->fun->run_program(dev);
+      t_run = firm_clock();
+
+	/* Tell the driver what is now running on the board. */
+      if (rc_ise == ISE_OK && dev->fun->set_firmware_id)
+	    dev->fun->set_firmware_id(dev, firm_id);
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s: firmware load times: read %.1fms, "
+		    "restart+open %.1fms, send %.1fms (%.1f MB/s), "
+		    "sync %.1fms, run %.1fms, total %.1fms\n", dev->id_str,
+		    (t_read-t_start)*1000.0, (t_open-t_read)*1000.0,
+		    (t_send-t_open)*1000.0,
+		    t_send > t_open? ndata / (t_send-t_open) / 1e6 : 0.0,
+		    (t_sync-t_send)*1000.0, (t_run-t_sync)*1000.0,
+		    (t_run-t_start)*1000.0);
+	    fflush(__ise_logfile);
+      }
+
+      return rc_ise;
 }
 
 ise_error_t ise_channel(struct ise_handle*dev, unsigned cid)
@@ -174,6 +552,11 @@ ise_error_t ise_channel(struct ise_handle*dev, unsigned cid)
       struct ise_channel*chn;
       ise_error_t rc;
 
+      if (cid >= ISE_CHANNEL_MAX)
+	    return ISE_NO_CHANNEL;
+      if (dev->chan_map[cid])
+	    return ISE_CHANNEL_BUSY;
+
       chn = calloc(1, sizeof (struct ise_channel));
       chn->cid = cid;
       chn->fd  = -1;
@@ -188,14 +571,50 @@ ise_error_t ise_channel(struct ise_handle*dev, unsigned cid)
 
       chn->next = dev->clist;
       dev->clist = chn;
+      dev->chan_map[cid] = chn;
 
       return ISE_OK;
 }
 
+ise_error_t ise_channels(struct ise_handle*dev, const unsigned*ids, size_t n)
+{
+      ise_error_t rc = ISE_OK;
+      size_t idx;
+      int batch;
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s: open %zu channels\n", dev->id_str, n);
+	    fflush(__ise_logfile);
+      }
+
+      batch = dev->fun->root_batch != 0
+	    && dev->fun->root_batch(dev, 1) == ISE_OK;
+
+      for (idx = 0 ;  idx < n ;  idx += 1) {
+	    rc = ise_channel(dev, ids[idx]);
+	    if (rc != ISE_OK) {
+		  if (__ise_logfile) {
+			fprintf(__ise_logfile, "%s: channel %u failed: %s\n",
+				dev->id_str, ids[idx], ise_error_msg(rc));
+			fflush(__ise_logfile);
+		  }
+		  break;
+	    }
+      }
+
+      if (batch)
+	    dev->fun->root_batch(dev, 0);
+
+      return rc;
+}
+
 void* ise_make_frame(struct ise_handle*dev, unsigned id, size_t*siz)
 {
       ise_error_t rc;
 
+      if (id >= ISE_FRAME_MAX)
+	    return 0;
+
       if (dev->frame[id].base) {
 	    *siz = dev->frame[id].size;
 	    return dev->frame[id].base;
@@ -225,12 +644,77 @@ void ise_delete_frame(struct ise_handle*dev, unsigned id)
 {
       assert(dev);
 
-      if (dev->frame[id].base == 0)
+      if (id >= ISE_FRAME_MAX || dev->frame[id].base == 0)
 	    return;
 
       dev->fun->delete_frame(dev, id);
 }
 
+ise_error_t ise_frame_prefault(struct ise_handle*dev, unsigned id, int flag)
+{
+      if (id >= ISE_FRAME_MAX)
+	    return ISE_ERROR;
+
+      dev->frame[id].prefault = flag? 1 : 0;
+      return ISE_OK;
+}
+
+long ise_frame_faults(struct ise_handle*dev, unsigned id)
+{
+      if (id >= ISE_FRAME_MAX || dev->frame[id].base == 0)
+	    return -1;
+      if (dev->fun->frame_faults == 0)
+	    return -1;
+
+      return dev->fun->frame_faults(dev, id);
+}
+
+int ise_frame_event_fd(struct ise_handle*dev)
+{
+      if (dev->fun->frame_event_fd == 0)
+	    return -1;
+
+      return dev->fun->frame_event_fd(dev);
+}
+
+ise_error_t ise_frame_event_read(struct ise_handle*dev,
+				 unsigned*done_seq, unsigned nframes)
+{
+      if (dev->fun->frame_event_read == 0)
+	    return ISE_ERROR;
+
+      return dev->fun->frame_event_read(dev, done_seq, nframes);
+}
+
+ise_error_t ise_heartbeat(struct ise_handle*dev, unsigned timeout_ms,
+			  unsigned*status, unsigned long*latency_us)
+{
+      double t_start, t_end;
+      unsigned tmp_status = 0;
+      ise_error_t rc;
+
+      if (dev->fun->heartbeat == 0)
+	    return ISE_ERROR;
+
+      t_start = firm_clock();
+      rc = dev->fun->heartbeat(dev, timeout_ms, &tmp_status);
+      t_end = firm_clock();
+
+      if (status)
+	    *status = tmp_status;
+      if (latency_us)
+	    *latency_us = (unsigned long) ((t_end - t_start) * 1e6);
+
+      if (__ise_logfile && rc != ISE_OK) {
+	    fprintf(__ise_logfile, "%s: heartbeat failed: %s "
+		    "(status=0x%04x)\n", dev->id_str, ise_error_msg(rc),
+		    tmp_status);
+	    fflush(__ise_logfile);
+      }
+
+      return rc;
+}
+
 ise_error_t ise_writeln(struct ise_handle*dev, unsigned cid,
 			const char*text)
 {
@@ -249,6 +733,78 @@ ise_error_t ise_writeln(struct ise_handle*dev, unsigned cid,
       return dev->fun->writeln(dev, chn, text);
 }
 
+ise_error_t ise_writev(struct ise_handle*dev, unsigned cid,
+		       const struct iovec*iov, int iovcnt)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+      struct iovec tmp[16];
+      struct iovec*use = tmp;
+      ise_error_t rc;
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+      if (iovcnt <= 0)
+	    return ISE_OK;
+
+	/* The driver writev modifies the array, so work on a copy. */
+      if (iovcnt > 16) {
+	    use = malloc(iovcnt * sizeof (struct iovec));
+	    if (use == 0)
+		  return ISE_ERROR;
+      }
+      memcpy(use, iov, iovcnt * sizeof (struct iovec));
+
+      rc = dev->fun->writev(dev, chn, use, iovcnt);
+
+      if (use != tmp)
+	    free(use);
+
+      return rc;
+}
+
+ise_error_t ise_writeln_batch(struct ise_handle*dev, unsigned cid,
+			      const char*const*lines, size_t nlines)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+      struct iovec tmp[32];
+      struct iovec*iov = tmp;
+      ise_error_t rc;
+      size_t idx;
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+      if (nlines == 0)
+	    return ISE_OK;
+
+      if (2*nlines > 32) {
+	    iov = malloc(2*nlines * sizeof (struct iovec));
+	    if (iov == 0)
+		  return ISE_ERROR;
+      }
+
+	/* Each line is its text followed by an EOL segment. */
+      for (idx = 0 ;  idx < nlines ;  idx += 1) {
+	    if (__ise_logfile)
+		  fprintf(__ise_logfile, "%s.%u: writeln_batch(%s)\n",
+			  dev->id_str, chn->cid, lines[idx]);
+
+	    iov[2*idx+0].iov_base = (void*)lines[idx];
+	    iov[2*idx+0].iov_len  = strlen(lines[idx]);
+	    iov[2*idx+1].iov_base = "\n";
+	    iov[2*idx+1].iov_len  = 1;
+      }
+
+      if (__ise_logfile)
+	    fflush(__ise_logfile);
+
+      rc = dev->fun->writev(dev, chn, iov, 2*nlines);
+
+      if (iov != tmp)
+	    free(iov);
+
+      return rc;
+}
+
 ise_error_t ise_readln(struct ise_handle*dev, unsigned cid,
 		       char*buf, size_t nbuf)
 {
@@ -265,13 +821,44 @@ ise_error_t ise_readln(struct ise_handle*dev, unsigned cid,
 	    fflush(__ise_logfile);
       }
 
+      if (nbuf == 0)
+	    return ISE_ERROR;
+
       bp = buf;
-      do {
-	    while (chn->fill > 0) {
-		  *bp = chn->buf[chn->ptr];
-		  chn->ptr += 1;
-		  chn->fill -= 1;
-		  if (*bp == '\n') {
+      for (;;) {
+	    if (chn->fill > 0) {
+		  const char*src = chn->buf + chn->ptr;
+		  const char*nl = memchr(src, '\n', chn->fill);
+		  size_t trans = nl? (size_t)(nl - src) : chn->fill;
+		  size_t room = buf + nbuf - 1 - bp;
+
+		    /* If the line does not fit, return what fits and
+		       leave the rest in the channel. */
+		  if (trans > room) {
+			memcpy(bp, src, room);
+			bp += room;
+			chn->ptr  += room;
+			chn->fill -= room;
+			*bp = 0;
+
+			if (__ise_logfile) {
+			      fprintf(__ise_logfile, "%s.%u: readln buffer "
+				      "overrun\n", dev->id_str, chn->cid);
+			      fflush(__ise_logfile);
+			}
+
+			return ISE_ERROR;
+		  }
+
+		  memcpy(bp, src, trans);
+		  bp += trans;
+		  chn->ptr  += trans;
+		  chn->fill -= trans;
+
+		  if (nl) {
+			  /* Consume the EOL as well. */
+			chn->ptr  += 1;
+			chn->fill -= 1;
 			*bp = 0;
 
 			if (__ise_logfile) {
@@ -282,7 +869,6 @@ ise_error_t ise_readln(struct ise_handle*dev, unsigned cid,
 
 			return ISE_OK;
 		  }
-		  bp += 1;
 	    }
 
 	    if (__ise_logfile) {
@@ -303,29 +889,236 @@ ise_error_t ise_readln(struct ise_handle*dev, unsigned cid,
 
 		  return rc;
 	    }
+      }
+}
 
+ise_error_t ise_write_msg(struct ise_handle*dev, unsigned cid,
+			  const void*data, size_t ndata)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+      unsigned char head[4];
+      struct iovec iov[2];
 
-      } while (bp < (buf+nbuf));
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+
+	/* The length must fit in the 4 byte header. */
+      if (ndata > UINT32_MAX)
+	    return ISE_ERROR;
 
       if (__ise_logfile) {
-	    fprintf(__ise_logfile, "%s.%u: readln buffer overrun\n",
-		    dev->id_str, chn->cid, buf);
+	    fprintf(__ise_logfile, "%s.%u: write_msg(%zu bytes)\n",
+		    dev->id_str, chn->cid, ndata);
 	    fflush(__ise_logfile);
       }
 
-      return ISE_ERROR;
+      head[0] = (ndata >>  0) & 0xff;
+      head[1] = (ndata >>  8) & 0xff;
+      head[2] = (ndata >> 16) & 0xff;
+      head[3] = (ndata >> 24) & 0xff;
+
+      iov[0].iov_base = head;
+      iov[0].iov_len  = sizeof head;
+      iov[1].iov_base = (void*)data;
+      iov[1].iov_len  = ndata;
+
+      return dev->fun->writev(dev, chn, iov, ndata? 2 : 1);
+}
+
+ise_error_t ise_read_msg(struct ise_handle*dev, unsigned cid,
+			 const void**data, size_t*ndata)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+      const unsigned char*head;
+      size_t len, got;
+      ise_error_t rc;
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+
+	/* Get the whole header into the buffer before consuming any
+	   of it, so that a read timeout leaves the channel intact. */
+      while (chn->fill < 4) {
+	    rc = dev->fun->readbuf(dev, chn);
+	    if (rc != ISE_OK)
+		  return rc;
+      }
+
+      head = (const unsigned char*)chn->buf + chn->ptr;
+      len = (size_t)head[0]
+	  | ((size_t)head[1] <<  8)
+	  | ((size_t)head[2] << 16)
+	  | ((size_t)head[3] << 24);
+
+	/* The usual case is a message that fits in the channel
+	   buffer. Return it in place. */
+      if (4 + len <= sizeof chn->buf) {
+	    while (chn->fill < 4 + len) {
+		  rc = dev->fun->readbuf(dev, chn);
+		  if (rc != ISE_OK)
+			return rc;
+	    }
+
+	    *data = chn->buf + chn->ptr + 4;
+	    *ndata = len;
+	    chn->ptr  += 4 + len;
+	    chn->fill -= 4 + len;
+
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: read_msg -->%zu bytes\n",
+			  dev->id_str, chn->cid, len);
+		  fflush(__ise_logfile);
+	    }
+	    return ISE_OK;
+      }
+
+	/* The message is larger then the channel buffer, so collect
+	   it in the message buffer. */
+      if (len > chn->msg_size) {
+	    char*tmp = realloc(chn->msg, len);
+	    if (tmp == 0)
+		  return ISE_ERROR;
+	    chn->msg = tmp;
+	    chn->msg_size = len;
+      }
+
+      chn->ptr  += 4;
+      chn->fill -= 4;
+
+      got = 0;
+      while (got < len) {
+	    size_t trans;
+
+	    if (chn->fill == 0) {
+		  rc = dev->fun->readbuf(dev, chn);
+		  if (rc != ISE_OK) {
+			if (__ise_logfile) {
+			      fprintf(__ise_logfile, "%s.%u: read_msg lost "
+				      "%zu of %zu bytes\n", dev->id_str,
+				      chn->cid, len - got, len);
+			      fflush(__ise_logfile);
+			}
+			return rc;
+		  }
+	    }
+
+	    trans = len - got;
+	    if (trans > chn->fill)
+		  trans = chn->fill;
+
+	    memcpy(chn->msg + got, chn->buf + chn->ptr, trans);
+	    got += trans;
+	    chn->ptr  += trans;
+	    chn->fill -= trans;
+      }
+
+      *data = chn->msg;
+      *ndata = len;
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s.%u: read_msg -->%zu bytes\n",
+		    dev->id_str, chn->cid, len);
+	    fflush(__ise_logfile);
+      }
+      return ISE_OK;
 }
 
 ise_error_t ise_timeout(struct ise_handle*dev, unsigned cid,
 			long read_timeout)
 {
+      if (read_timeout > LONG_MAX / 1000)
+	    read_timeout = LONG_MAX / 1000;
+      if (read_timeout > 0)
+	    read_timeout *= 1000;
+
       return dev->fun->timeout(dev, cid, read_timeout);
 }
 
-struct ise_handle*ise_bind(const char*name)
+ise_error_t ise_timeout_us(struct ise_handle*dev, unsigned cid,
+			   long read_timeout_us)
+{
+      return dev->fun->timeout(dev, cid, read_timeout_us);
+}
+
+ise_error_t ise_channel_ring(struct ise_handle*dev, unsigned cid,
+			     unsigned*depth, size_t*buf_size)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+      ise_error_t rc;
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s.%u: request ring of %u buffers "
+		    "of %zu bytes\n", dev->id_str, cid, *depth, *buf_size);
+	    fflush(__ise_logfile);
+      }
+
+      rc = dev->fun->channel_ring(dev, chn, depth, buf_size);
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s.%u: ring is %u buffers "
+		    "of %zu bytes\n", dev->id_str, cid, *depth, *buf_size);
+	    fflush(__ise_logfile);
+      }
+
+      return rc;
+}
+
+ise_error_t ise_ring_out_buffer(struct ise_handle*dev, unsigned cid,
+				void**buf, size_t*nbuf)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+      if (dev->fun->ring_out_buffer == 0)
+	    return ISE_ERROR;
+
+      return dev->fun->ring_out_buffer(dev, chn, buf, nbuf);
+}
+
+ise_error_t ise_ring_out_publish(struct ise_handle*dev, unsigned cid,
+				 size_t count)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+      if (dev->fun->ring_out_publish == 0)
+	    return ISE_ERROR;
+
+      return dev->fun->ring_out_publish(dev, chn, count);
+}
+
+ise_error_t ise_ring_in_buffer(struct ise_handle*dev, unsigned cid,
+			       const void**buf, size_t*count)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+      if (dev->fun->ring_in_buffer == 0)
+	    return ISE_ERROR;
+
+      return dev->fun->ring_in_buffer(dev, chn, buf, count);
+}
+
+ise_error_t ise_ring_in_release(struct ise_handle*dev, unsigned cid)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+      if (dev->fun->ring_in_release == 0)
+	    return ISE_ERROR;
+
+      return dev->fun->ring_in_release(dev, chn);
+}
+
+void __ise_log_init(void)
 {
-      struct ise_handle*dev;
-      unsigned id = 0;
       char*logpath;
 
       if ((__ise_logfile == 0) && ((logpath = getenv("LIBISEIO_LOG")))) {
@@ -345,6 +1138,14 @@ struct ise_handle*ise_bind(const char*name)
 		  __ise_logfile = fopen(logpath, "a");
 	    }
       }
+}
+
+struct ise_handle*ise_bind(const char*name)
+{
+      struct ise_handle*dev;
+      unsigned id = 0;
+
+      __ise_log_init();
 
       if (__ise_logfile)
 	    fprintf(__ise_logfile, "ise: **** ise_bind(%s)\n", name);
@@ -354,6 +1155,9 @@ struct ise_handle*ise_bind(const char*name)
       dev->version = 0;
       dev->isex = -1;
       dev->clist = 0;
+      dev->epfd = -1;
+      dev->ready_fd = -1;
+      dev->event_fd = -1;
 
       if (__driver_ise.probe_id(dev) != 0)
 	    dev->fun = &__driver_ise;
@@ -369,29 +1173,17 @@ struct ise_handle*ise_bind(const char*name)
       return dev;
 }
 
-struct ise_handle*ise_open(const char*name)
+/*
+ * Read the ident text from the PROM monitor of the board into
+ * dev->version. This resets the board to get to the monitor, and
+ * leaves the board in the monitor. If the monitor port cannot be
+ * opened, the ident is left empty and is not cached.
+ */
+static void probe_prom_ident(struct ise_handle*dev)
 {
-      struct ise_handle*dev;
-      char*logpath;
       ise_error_t rc;
       struct ise_channel mon;
 
-      dev = ise_bind(name);
-
-      if (__ise_logfile)
-	    fprintf(__ise_logfile, "ise: **** ise_open(%s)\n", name);
-
-      rc = dev->fun->connect(dev);
-      if (rc != ISE_OK) {
-
-	    if (__ise_logfile)
-		  fprintf(__ise_logfile, "%s: Control file failed.\n", dev->id_str);
-
-	    free(dev->id_str);
-	    free(dev);
-	    return 0;
-      }
-
       if (__ise_logfile)
 	    fprintf(__ise_logfile, "%s: Restart device\n", dev->id_str);
 
@@ -404,7 +1196,20 @@ struct ise_handle*ise_open(const char*name)
       mon.cid = 254;
       mon.ptr = 0;
       mon.fill = 0;
+      mon.ring_table = 0;
+      mon.ring_data  = 0;
       rc = dev->fun->channel_open(dev, &mon);
+      if (rc != ISE_OK) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s: Unable to open monitor port: %s\n",
+			  dev->id_str, ise_error_msg(rc));
+		  fflush(__ise_logfile);
+	    }
+
+	      /* Leave an empty ident so that the handle still works. */
+	    dev->version = strdup("");
+	    return;
+      }
 
       if (__ise_logfile)
 	    fprintf(__ise_logfile, "%s: reading ident data\n", dev->id_str);
@@ -464,57 +1269,124 @@ struct ise_handle*ise_open(const char*name)
 	dev->version = realloc(dev->version, (cp- dev->version) + 1);
       }
 
-	/* All done with this setup. Close the monitor channel and
-	   reset the ISE board. */
+	/* All done with this setup. Close the monitor channel. */
       dev->fun->channel_close(dev, &mon);
-
-      if (__ise_logfile)
-	    fprintf(__ise_logfile, "%s: Restart device\n", dev->id_str);
-
-      dev->fun->restart(dev);
-
-      if (__ise_logfile)
-	    fprintf(__ise_logfile, "%s: ise_open(%s) complete.\n",
-		    dev->id_str, name);
-
-      return dev;
 }
 
-void ise_close(struct ise_handle*dev)
+/*
+ * Open the board and get its PROM ident. Reading the ident from the
+ * PROM monitor takes a board reset, so the ident is cached in the
+ * driver and read from the PROM only the first time. If lazy is
+ * false, then the board is also reset, as ise_open promises. If lazy
+ * is true, the board is left as it is, for the ise_restart that is
+ * to follow to reset it, or to find the same program running.
+ */
+static struct ise_handle*open_board(const char*name, int lazy)
 {
-      unsigned idx;
+      struct ise_handle*dev;
+      ise_error_t rc;
+      char*ident = 0;
+      int reset_flag = 0;
+
+      dev = ise_bind(name);
+      if (dev == 0)
+	    return 0;
 
       if (__ise_logfile)
-	    fprintf(__ise_logfile, "%s: **** ise_close\n", dev->id_str);
+	    fprintf(__ise_logfile, "ise: **** %s(%s)\n",
+		    lazy? "ise_open_lazy" : "ise_open", name);
 
-      for (idx = 0 ;  idx < 16 ;  idx += 1) {
-	    if (dev->frame[idx].base == 0)
-		  continue;
+      rc = dev->fun->connect(dev);
+      if (rc != ISE_OK) {
 
 	    if (__ise_logfile)
-		  fprintf(__ise_logfile, "%s: delete frame %u\n",
-			  dev->id_str, idx);
+		  fprintf(__ise_logfile, "%s: Control file failed.\n", dev->id_str);
 
-	    ise_delete_frame(dev, idx);
+	    free(dev->id_str);
+	    free(dev);
+	    return 0;
       }
 
-      while (dev->clist) {
-	    struct ise_channel*chn = dev->clist;
-	    dev->clist = chn->next;
+      if (dev->fun->get_prom_ident)
+	    dev->fun->get_prom_ident(dev, &ident);
 
+      if (ident) {
 	    if (__ise_logfile)
-		  fprintf(__ise_logfile, "%s: Close channel %u\n",
-			  dev->id_str, chn->cid);
+		  fprintf(__ise_logfile, "%s: Using cached ident data\n",
+			  dev->id_str);
+	    dev->version = ident;
 
-	    dev->fun->channel_close(dev, chn);
-	    free(chn);
+      } else {
+	    probe_prom_ident(dev);
+	    if (dev->fun->set_prom_ident && dev->version[0])
+		  dev->fun->set_prom_ident(dev, dev->version);
+
+	      /* The probe reset the board, so a lazy open need not
+		 do it again. */
+	    reset_flag = 1;
       }
 
-      if (dev->version) {
+	/* Reset the ISE board so that it is clean for the caller. The
+	   probe leaves the board in the monitor, so the reset is
+	   needed even after a probe. */
+      if (! lazy) {
 	    if (__ise_logfile)
-		  fprintf(__ise_logfile, "%s: Reset board.\n", dev->id_str);
+		  fprintf(__ise_logfile, "%s: Restart device\n", dev->id_str);
 
 	    dev->fun->restart(dev);
+	    reset_flag = 1;
+      }
+
+      if (__ise_logfile)
+	    fprintf(__ise_logfile, "%s: %s(%s) complete%s.\n",
+		    dev->id_str, lazy? "ise_open_lazy" : "ise_open", name,
+		    reset_flag? "" : " (board not reset)");
+
+      return dev;
+}
+
+struct ise_handle*ise_open(const char*name)
+{
+      return open_board(name, 0);
+}
+
+struct ise_handle*ise_open_lazy(const char*name)
+{
+      return open_board(name, 1);
+}
+
+void ise_close(struct ise_handle*dev)
+{
+      if (__ise_logfile)
+	    fprintf(__ise_logfile, "%s: **** ise_close\n", dev->id_str);
+
+      close_frames_and_channels(dev);
+
+      if (dev->epfd >= 0)
+	    close(dev->epfd);
+      if (dev->ready_fd >= 0)
+	    close(dev->ready_fd);
+      if (dev->event_fd >= 0)
+	    close(dev->event_fd);
+
+      if (dev->version) {
+	    char cur_id[128];
+
+	      /* If asked to, leave a board that runs a program from
+		 ise_restart running, for the next process that loads
+		 the same image. */
+	    if (getenv("LIBISEIO_KEEP_FIRMWARE")
+		&& firm_running(dev, cur_id, sizeof cur_id)) {
+		  if (__ise_logfile)
+			fprintf(__ise_logfile, "%s: Leave firmware %s "
+				"running.\n", dev->id_str, cur_id);
+	    } else {
+		  if (__ise_logfile)
+			fprintf(__ise_logfile, "%s: Reset board.\n",
+				dev->id_str);
+
+		  dev->fun->restart(dev);
+	    }
 
 	    free(dev->version);
 
@@ -528,6 +1400,11 @@ void ise_close(struct ise_handle*dev)
 	    }
       }
 
+	/* The control device may be open even for an ise_bind
+	   handle, if ise_heartbeat was used. */
+      if (dev->isex >= 0)
+	    close(dev->isex);
+
       if (__ise_logfile)
 	    fprintf(__ise_logfile, "%s: **** ise_close complete\n", dev->id_str);
 
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  <libiseio.h>
+# include  "priv.h"
+
+# include  <stdlib.h>
+# include  <stdio.h>
+# include  <pthread.h>
+
+/*
+ * The boards are brought up by one worker thread each. The handles
+ * share nothing, so the workers need no locking among themselves,
+ * and the total time is that of the slowest board. The log file is
+ * opened before the workers start, and stdio locks each fprintf, so
+ * the lines of the workers may interleave but are not garbled.
+ */
+struct bringup_work {
+      const char*name;
+      const char*firm;
+      struct ise_handle*dev;
+      ise_error_t rc;
+};
+
+static void* open_worker(void*arg)
+{
+      struct bringup_work*work = (struct bringup_work*)arg;
+
+	/* The restart resets the board anyhow, so the open need not. */
+      if (work->firm)
+	    work->dev = ise_open_lazy(work->name);
+      else
+	    work->dev = ise_open(work->name);
+      if (work->dev == 0) {
+	    work->rc = ISE_ERROR;
+	    return 0;
+      }
+
+      if (work->firm)
+	    work->rc = ise_restart(work->dev, work->firm);
+      else
+	    work->rc = ISE_OK;
+
+      return 0;
+}
+
+static void* restart_worker(void*arg)
+{
+      struct bringup_work*work = (struct bringup_work*)arg;
+
+      if (work->dev == 0)
+	    work->rc = ISE_ERROR;
+      else
+	    work->rc = ise_restart(work->dev, work->firm);
+
+      return 0;
+}
+
+/*
+ * Run the worker function on every item, each in its own thread, and
+ * wait for them all. If a thread cannot be started, then the item is
+ * done by this thread after the others are started.
+ */
+static void run_workers(struct bringup_work*work, unsigned n,
+			void* (*fun)(void*))
+{
+      pthread_t*tids;
+      int*started;
+      unsigned idx;
+
+      __ise_log_init();
+
+      tids = calloc(n, sizeof(pthread_t));
+      started = calloc(n, sizeof(int));
+
+      for (idx = 0 ;  idx < n ;  idx += 1) {
+	    if (tids && started)
+		  started[idx] = pthread_create(tids+idx, 0, fun, work+idx) == 0;
+      }
+
+      for (idx = 0 ;  idx < n ;  idx += 1) {
+	    if (started && started[idx])
+		  continue;
+
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s: no worker thread, "
+			  "bring up serially\n", work[idx].name);
+		  fflush(__ise_logfile);
+	    }
+	    fun(work+idx);
+      }
+
+      for (idx = 0 ;  idx < n ;  idx += 1) {
+	    if (started && started[idx])
+		  pthread_join(tids[idx], 0);
+      }
+
+      free(started);
+      free(tids);
+}
+
+/*
+ * Collect the results of the workers into the rcs array (if there is
+ * one) and the log, and return the first error, or ISE_OK.
+ */
+static ise_error_t report_workers(const struct bringup_work*work, unsigned n,
+				  ise_error_t*rcs, const char*what)
+{
+      ise_error_t rc = ISE_OK;
+      unsigned nfail = 0;
+      unsigned idx;
+
+      for (idx = 0 ;  idx < n ;  idx += 1) {
+	    if (rcs)
+		  rcs[idx] = work[idx].rc;
+	    if (work[idx].rc == ISE_OK)
+		  continue;
+
+	    if (rc == ISE_OK)
+		  rc = work[idx].rc;
+	    nfail += 1;
+
+	    if (__ise_logfile)
+		  fprintf(__ise_logfile, "%s: %s failed: %s\n", work[idx].name,
+			  what, ise_error_msg(work[idx].rc));
+      }
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "ise: **** %s of %u boards: %u failed\n",
+		    what, n, nfail);
+	    fflush(__ise_logfile);
+      }
+
+      return rc;
+}
+
+ise_error_t ise_open_many(const char*const*names, unsigned n,
+			  const char*firm, struct ise_handle**devs,
+			  ise_error_t*rcs)
+{
+      struct bringup_work*work;
+      ise_error_t rc;
+      unsigned idx;
+
+      if (n == 0)
+	    return ISE_OK;
+
+      work = calloc(n, sizeof(struct bringup_work));
+      if (work == 0)
+	    return ISE_ERROR;
+
+      for (idx = 0 ;  idx < n ;  idx += 1) {
+	    work[idx].name = names[idx];
+	    work[idx].firm = firm;
+	    work[idx].dev  = 0;
+	    work[idx].rc   = ISE_ERROR;
+      }
+
+      run_workers(work, n, &open_worker);
+
+      for (idx = 0 ;  idx < n ;  idx += 1)
+	    devs[idx] = work[idx].dev;
+
+      rc = report_workers(work, n, rcs, firm? "open and restart" : "open");
+      free(work);
+      return rc;
+}
+
+ise_error_t ise_restart_many(struct ise_handle*const*devs, unsigned n,
+			     const char*firm, ise_error_t*rcs)
+{
+      struct bringup_work*work;
+      ise_error_t rc;
+      unsigned idx;
+
+      if (n == 0)
+	    return ISE_OK;
+
+      work = calloc(n, sizeof(struct bringup_work));
+      if (work == 0)
+	    return ISE_ERROR;
+
+      for (idx = 0 ;  idx < n ;  idx += 1) {
+	    work[idx].name = devs[idx]? devs[idx]->id_str : "(null)";
+	    work[idx].firm = firm;
+	    work[idx].dev  = devs[idx];
+	    work[idx].rc   = ISE_ERROR;
+      }
+
+      run_workers(work, n, &restart_worker);
+
+      rc = report_workers(work, n, rcs, "restart");
+      free(work);
+      return rc;
+}
@@ -226,12 +226,19 @@ static ise_error_t channel_open_plug(struct ise_handle*dev,
 	/* Accept the connection from the remote. Close and unlink the
 	   named pipe, and leave the client pipe open. */
       struct sockaddr remote_addr;
-      socklen_t remote_addr_len;
+      socklen_t remote_addr_len = sizeof remote_addr;
       int use_fd = accept(fd, &remote_addr, &remote_addr_len);
 
       close(fd);
       unlink(addr.sun_path);
 
+      if (use_fd < 0) {
+	    if (__ise_logfile)
+		  fprintf(__ise_logfile, "%s: accept channel %u failed "
+			  "(errno=%d)\n", dev->id_str, chn->cid, errno);
+	    return ISE_ERROR;
+      }
+
       chn->fd = use_fd;
 
       return ISE_OK;
@@ -267,7 +274,7 @@ static ise_error_t channel_close_plug(struct ise_handle*dev,
 }
 
 static ise_error_t timeout_plug(struct ise_handle*dev, unsigned cid,
-				long read_timeout)
+				long read_timeout_us)
 {
       if (__ise_logfile) {
 	    fprintf(__ise_logfile, "%s: timeout not implemented\n", dev->id_str);
@@ -276,6 +283,17 @@ static ise_error_t timeout_plug(struct ise_handle*dev, unsigned cid,
       return ISE_ERROR;
 }
 
+static ise_error_t channel_ring_plug(struct ise_handle*dev,
+				     struct ise_channel*chn,
+				     unsigned*depth, size_t*buf_size)
+{
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s: channel_ring not implemented\n", dev->id_str);
+      }
+
+      return ISE_ERROR;
+}
+
 static ise_error_t make_frame_plug(struct ise_handle*dev, unsigned id)
 {
       if (__ise_logfile) {
@@ -321,7 +339,7 @@ static ise_error_t make_frame_plug(struct ise_handle*dev, unsigned id)
 
 static void delete_frame_plug(struct ise_handle*dev, unsigned id)
 {
-      if (id >= 16)
+      if (id >= ISE_FRAME_MAX)
 	    return;
 
       if (dev->frame[id].base == 0)
@@ -341,24 +359,35 @@ static ise_error_t write_plug(struct ise_handle*dev,
       return ISE_OK;
 }
 
+static ise_error_t writev_plug(struct ise_handle*dev,
+			       struct ise_channel*chn,
+			       struct iovec*iov, int iovcnt)
+{
+      if (__ise_writev_all(chn->fd, iov, iovcnt) < 0)
+	    return ISE_ERROR;
+
+      return ISE_OK;
+}
+
 static ise_error_t writeln_plug(struct ise_handle*dev,
 				struct ise_channel*chn,
 				const char*text)
 {
-      int rc;
-      char nl;
-      rc = write(chn->fd, text, strlen(text));
-      assert(rc == strlen(text));
+      struct iovec iov[2];
+      ise_error_t rc;
+
+      iov[0].iov_base = (void*)text;
+      iov[0].iov_len  = strlen(text);
+      iov[1].iov_base = "\n";
+      iov[1].iov_len  = 1;
+
+      rc = writev_plug(dev, chn, iov, 2);
 
       if (__ise_logfile)
-	    fprintf(__ise_logfile, "%s.%u: write returns rc=%d\n",
+	    fprintf(__ise_logfile, "%s.%u: writeln returns rc=%d\n",
 		    dev->id_str, chn->cid, rc);
 
-      nl = '\n';
-      rc = write(chn->fd, &nl, 1);
-      assert(rc == 1);
-
-      return ISE_OK;
+      return rc;
 }
 
 static ise_error_t readbuf_plug(struct ise_handle*dev,
@@ -366,7 +395,9 @@ static ise_error_t readbuf_plug(struct ise_handle*dev,
 {
       int rc;
 
-      rc = read(chn->fd, chn->buf, sizeof chn->buf);
+      __ise_compact(chn);
+      rc = read(chn->fd, chn->buf + chn->fill,
+		sizeof chn->buf - chn->fill);
 
       if (__ise_logfile) {
 	    fprintf(__ise_logfile, "%s.%u: read returned (%d)...\n",
@@ -384,11 +415,64 @@ static ise_error_t readbuf_plug(struct ise_handle*dev,
 	    return ISE_ERROR;
       }
 
-      chn->ptr = 0;
-      chn->fill = rc;
+      chn->fill += rc;
+      return ISE_OK;
+}
+/*
+ * The channels are sockets, so the non-blocking functions are plain
+ * non-blocking socket I/O. There is nothing to flush.
+ */
+static ise_error_t write_nb_plug(struct ise_handle*dev,
+				 struct ise_channel*chn,
+				 const void*buf, size_t nbuf, size_t*nput)
+{
+      ssize_t rc = write(chn->fd, buf, nbuf);
+
+      if (rc < 0) {
+	    *nput = 0;
+	    if (errno == EAGAIN || errno == EWOULDBLOCK)
+		  return ISE_WOULD_BLOCK;
+
+	    return ISE_ERROR;
+      }
+
+      *nput = rc;
+      return ISE_OK;
+}
+
+static ise_error_t flush_nb_plug(struct ise_handle*dev,
+				 struct ise_channel*chn)
+{
+      return ISE_OK;
+}
+
+static ise_error_t readbuf_nb_plug(struct ise_handle*dev,
+				   struct ise_channel*chn)
+{
+      int rc;
+
+      __ise_compact(chn);
+      rc = read(chn->fd, chn->buf + chn->fill,
+		sizeof chn->buf - chn->fill);
+
+      if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	    return ISE_WOULD_BLOCK;
+
+      if (rc <= 0) {
+	    if (__ise_logfile) {
+		  fprintf(__ise_logfile, "%s.%u: read errorno=%d\n",
+			  dev->id_str, chn->cid, rc < 0? errno : 0);
+		  fflush(__ise_logfile);
+	    }
+
+	    return ISE_ERROR;
+      }
+
+      chn->fill += rc;
       return ISE_OK;
 }
 
+
 const struct ise_driver_functions __driver_plug = {
  probe_id: probe_id_plug,
  connect: connect_plug,
@@ -399,11 +483,17 @@ const struct ise_driver_functions __driver_plug = {
  channel_close: channel_close_plug,
  channel_sync: channel_sync_plug,
  timeout: timeout_plug,
+ channel_ring: channel_ring_plug,
 
  make_frame:  make_frame_plug,
  delete_frame: delete_frame_plug,
 
  write: write_plug,
+ writev: writev_plug,
  writeln: writeln_plug,
  readbuf: readbuf_plug,
+
+ write_nb: write_nb_plug,
+ flush_nb: flush_nb_plug,
+ readbuf_nb: readbuf_nb_plug,
 };
@@ -22,6 +22,10 @@
 
 # include  <stddef.h>
 # include  <stdio.h>
+# include  <sys/uio.h>
+
+struct ise_async_op;
+struct ise_stash;
 
 struct ise_channel {
       struct ise_channel*next;
@@ -29,26 +33,99 @@ struct ise_channel {
       int fd;
       char buf[4096];
       unsigned ptr, fill;
+
+	/* If the process uses the channel ring buffers in place, these
+	   are the mappings of the ring table and of the buffers. They
+	   are 0 if the ring is not mapped. */
+      void*ring_table;
+      void*ring_data;
+      size_t ring_size;
+
+	/* Asynchronous I/O state. The async_events are the epoll
+	   events the fd is registered for, or 0 if the channel is not
+	   in the epoll set. The line collects a partial input line
+	   for the read at the head of the rd_queue. */
+      int async_flag;
+      unsigned async_events;
+      struct ise_async_op*rd_queue;
+      struct ise_async_op*wr_queue;
+      char*line;
+      size_t line_fill, line_size;
+
+	/* Messages too large for the buf are collected here. */
+      char*msg;
+      size_t msg_size;
+
+	/* Tagged response lines that arrived while waiting for some
+	   other tag. */
+      struct ise_stash*stash;
 };
 
+/*
+ * This is the number of channels that the root table has room for
+ * (ROOT_TABLE_CHANNELS) so valid channel ids are less then this.
+ */
+# define ISE_CHANNEL_MAX 495
+
 struct ise_handle {
       char*id_str;
       int isex;
       char*version;
       struct ise_channel*clist;
 
+	/* Open channels indexed by channel id. The clist has the same
+	   channels, and is used to walk them. */
+      struct ise_channel*chan_map[ISE_CHANNEL_MAX];
+
+	/* The epoll fd for asynchronous I/O, or -1 if not made yet.
+	   The ready_fd is an eventfd in the epoll set, which is made
+	   readable when there is buffered work that the channel fds
+	   do not show. */
+      int epfd;
+      int ready_fd;
+
+	/* A second, non-blocking, open of the control device for frame
+	   events, or -1 if ise_frame_event_fd was not called. */
+      int event_fd;
+
       struct {
 	    void*base;
 	    size_t size;
-      } frame[16];
+	    int prefault;
+      } frame[ISE_FRAME_MAX];
 
 	/* Low level implementation functions. */
       const struct ise_driver_functions*fun;
 };
 
 extern FILE*__ise_logfile;
+
+/*
+ * Open the log file named by LIBISEIO_LOG, if it is not open
+ * already. This is called before starting threads that log, so that
+ * they do not race to open it.
+ */
+extern void __ise_log_init(void);
 extern struct ise_channel*__ise_find_channel(struct ise_handle*dev, unsigned cid);
 
+/*
+ * Move the unread bytes of the channel buffer to the front, so that
+ * a readbuf can append to them.
+ */
+extern void __ise_compact(struct ise_channel*chn);
+
+/*
+ * Write all the iovec segments to the fd, continuing after partial
+ * writes. The iov array is modified. Return 0 or -1.
+ */
+extern int __ise_writev_all(int fd, struct iovec*iov, int iovcnt);
+
+/* Discard the asynchronous state of a channel that is being closed. */
+extern void __ise_async_close(struct ise_handle*dev, struct ise_channel*chn);
+
+/* Discard the stashed response lines of a channel. */
+extern void __ise_stash_clear(struct ise_channel*chn);
+
 
 struct ise_driver_functions {
 
@@ -67,6 +144,24 @@ struct ise_driver_functions {
 	/* Send a command to run the program on the remote. */
       ise_error_t (*run_program)(struct ise_handle*dev);
 
+	/* Get or set the id of the firmware that the board is
+	   running. An empty id means not known. These may be 0 if the
+	   driver does not keep the id. */
+      ise_error_t (*get_firmware_id)(struct ise_handle*dev,
+				     char*id, size_t nid);
+      ise_error_t (*set_firmware_id)(struct ise_handle*dev, const char*id);
+
+	/* Get or set the cached PROM ident text of the board. The
+	   get returns a malloced copy of the ident in *ident, or 0 if
+	   there is none cached. These may be 0 if the driver does not
+	   cache the ident. */
+      ise_error_t (*get_prom_ident)(struct ise_handle*dev, char**ident);
+      ise_error_t (*set_prom_ident)(struct ise_handle*dev, const char*ident);
+
+	/* Begin (flag=1) or commit (flag=0) a batch of channel
+	   changes. This may be 0 if the driver cannot batch. */
+      ise_error_t (*root_batch)(struct ise_handle*dev, int flag);
+
 	/* Open a channel by number and return the raw fd. */
       ise_error_t (*channel_open)(struct ise_handle*dev,
 				  struct ise_channel*chn);
@@ -75,25 +170,75 @@ struct ise_driver_functions {
       ise_error_t (*channel_close)(struct ise_handle*dev,
 				   struct ise_channel*chn);
 
-	/* Set the read timeout for a channel */
+	/* Set the read timeout for a channel, in microseconds, or an
+	   ISE_TIMEOUT_* value. */
       ise_error_t (*timeout)(struct ise_handle*dev, unsigned cid,
-			     long read_timeout);
+			     long read_timeout_us);
+
+	/* Negotiate the ring depth and buffer size of a channel. */
+      ise_error_t (*channel_ring)(struct ise_handle*dev,
+				  struct ise_channel*chn,
+				  unsigned*depth, size_t*buf_size);
+
+	/* Access the channel ring buffers in place. These may be 0 if
+	   the driver does not support mapped rings. */
+      ise_error_t (*ring_out_buffer)(struct ise_handle*dev,
+				     struct ise_channel*chn,
+				     void**buf, size_t*nbuf);
+      ise_error_t (*ring_out_publish)(struct ise_handle*dev,
+				      struct ise_channel*chn,
+				      size_t count);
+      ise_error_t (*ring_in_buffer)(struct ise_handle*dev,
+				    struct ise_channel*chn,
+				    const void**buf, size_t*count);
+      ise_error_t (*ring_in_release)(struct ise_handle*dev,
+				     struct ise_channel*chn);
 
       ise_error_t (*make_frame)(struct ise_handle*dev, unsigned id);
       void        (*delete_frame)(struct ise_handle*dev, unsigned id);
+	/* Return the page fault count of the frame. (optional) */
+      long        (*frame_faults)(struct ise_handle*dev, unsigned id);
+	/* Turn on frame events and return the fd that polls readable
+	   when a frame is done, and read the frame done sequence
+	   numbers without blocking. (optional) */
+      int         (*frame_event_fd)(struct ise_handle*dev);
+      ise_error_t (*frame_event_read)(struct ise_handle*dev,
+				      unsigned*done_seq, unsigned nframes);
+	/* Ping the board through its status registers and get its
+	   status word. (optional) */
+      ise_error_t (*heartbeat)(struct ise_handle*dev, unsigned timeout_ms,
+			       unsigned*status);
 
 	/* Write raw data through the channel */
       ise_error_t (*write)(struct ise_handle*dev,
 			   struct ise_channel*chn,
 			   const void*buf, size_t nbuf);
 
+	/* Write all the segments of the iovec to the channel, then
+	   flush. The iov array may be modified. */
+      ise_error_t (*writev)(struct ise_handle*dev,
+			    struct ise_channel*chn,
+			    struct iovec*iov, int iovcnt);
+
 	/* Write a line of text to the channel. */
       ise_error_t (*writeln)(struct ise_handle*dev,
 			     struct ise_channel*chn,
 			     const char*text);
 
-	/* Read bytes of text into the channel buffer. */
+	/* Read more bytes into the channel buffer. They are appended
+	   after any unread bytes already there. */
       ise_error_t (*readbuf)(struct ise_handle*dev, struct ise_channel*chn);
+
+	/* Non-blocking forms of write, flush and readbuf for the
+	   asynchronous I/O. The channel fd is already in non-blocking
+	   mode. These return ISE_WOULD_BLOCK instead of waiting. The
+	   write_nb writes as much as it can and returns in *nput the
+	   number of bytes taken. */
+      ise_error_t (*write_nb)(struct ise_handle*dev,
+			      struct ise_channel*chn,
+			      const void*buf, size_t nbuf, size_t*nput);
+      ise_error_t (*flush_nb)(struct ise_handle*dev, struct ise_channel*chn);
+      ise_error_t (*readbuf_nb)(struct ise_handle*dev, struct ise_channel*chn);
 };
 
 extern const struct ise_driver_functions __driver_ise;
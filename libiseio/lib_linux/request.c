@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  <libiseio.h>
+# include  "priv.h"
+
+# include  <stdlib.h>
+# include  <string.h>
+
+/*
+ * This is the tagged request/response engine. Requests are written
+ * as "<tag>command" lines without waiting for responses. Responses
+ * are read by tag. Lines that arrive for other tags while waiting
+ * are kept in the stash of the channel, in arrival order, until
+ * somebody asks for them.
+ */
+
+struct ise_stash {
+      struct ise_stash*next;
+      char text[0];
+};
+
+/*
+ * Return a pointer to the text after the tag if the line is for the
+ * given tag, or 0 if it is not. A null or empty tag matches lines
+ * that have no tag at all.
+ */
+static const char*match_tag(const char*line, const char*tag)
+{
+      size_t len;
+
+      if (tag == 0 || tag[0] == 0)
+	    return line[0] == '<'? 0 : line;
+
+      if (line[0] != '<')
+	    return 0;
+
+      len = strlen(tag);
+      if (strncmp(line+1, tag, len) != 0)
+	    return 0;
+      if (line[1+len] != '>')
+	    return 0;
+
+      return line + len + 2;
+}
+
+static void copy_out(char*buf, size_t nbuf, const char*text)
+{
+      size_t len = strlen(text);
+      if (len >= nbuf)
+	    len = nbuf - 1;
+
+      memcpy(buf, text, len);
+      buf[len] = 0;
+}
+
+ise_error_t ise_request(struct ise_handle*dev, unsigned cid,
+			const char*tag, const char*command)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+      struct iovec iov[5];
+      int first = 0;
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+
+	/* A null or empty tag sends the command untagged. */
+      if (tag == 0 || tag[0] == 0) {
+	    tag = "";
+	    first = 3;
+      }
+
+      if (__ise_logfile) {
+	    fprintf(__ise_logfile, "%s.%u: request <%s>%s\n",
+		    dev->id_str, chn->cid, tag, command);
+	    fflush(__ise_logfile);
+      }
+
+      iov[0].iov_base = "<";
+      iov[0].iov_len  = 1;
+      iov[1].iov_base = (void*)tag;
+      iov[1].iov_len  = strlen(tag);
+      iov[2].iov_base = ">";
+      iov[2].iov_len  = 1;
+      iov[3].iov_base = (void*)command;
+      iov[3].iov_len  = strlen(command);
+      iov[4].iov_base = "\n";
+      iov[4].iov_len  = 1;
+
+      return dev->fun->writev(dev, chn, iov + first, 5 - first);
+}
+
+ise_error_t ise_response(struct ise_handle*dev, unsigned cid,
+			 const char*tag, char*buf, size_t nbuf)
+{
+      struct ise_channel*chn = __ise_find_channel(dev, cid);
+      struct ise_stash**cur;
+      struct ise_stash*tmp;
+      const char*text;
+      char line[4096];
+      ise_error_t rc;
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+      if (nbuf == 0)
+	    return ISE_ERROR;
+
+	/* The line may already have arrived while waiting for some
+	   other tag. */
+      for (cur = &chn->stash ;  *cur ;  cur = &(*cur)->next) {
+	    text = match_tag((*cur)->text, tag);
+	    if (text == 0)
+		  continue;
+
+	    copy_out(buf, nbuf, text);
+	    tmp = *cur;
+	    *cur = tmp->next;
+	    free(tmp);
+	    return ISE_OK;
+      }
+
+	/* Read lines until one for this tag comes along. Stash the
+	   others at the end of the stash. */
+      for (;;) {
+	    rc = ise_readln(dev, cid, line, sizeof line);
+	    if (rc != ISE_OK)
+		  return rc;
+
+	    text = match_tag(line, tag);
+	    if (text) {
+		  copy_out(buf, nbuf, text);
+		  return ISE_OK;
+	    }
+
+	    tmp = malloc(sizeof (struct ise_stash) + strlen(line) + 1);
+	    if (tmp == 0)
+		  return ISE_ERROR;
+	    strcpy(tmp->text, line);
+	    tmp->next = 0;
+	    *cur = tmp;
+	    cur = &tmp->next;
+      }
+}
+
+void __ise_stash_clear(struct ise_channel*chn)
+{
+      while (chn->stash) {
+	    struct ise_stash*tmp = chn->stash;
+	    chn->stash = tmp->next;
+	    free(tmp);
+      }
+}
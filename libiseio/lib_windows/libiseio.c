@@ -26,6 +26,15 @@ struct ise_channel {
       HANDLE fd;
       char buf[1024];
       unsigned ptr, fill;
+
+	/* Tagged response lines that arrived while waiting for some
+	   other tag. */
+      struct ise_stash*stash;
+};
+
+struct ise_stash {
+      struct ise_stash*next;
+      char text[1];
 };
 
 struct ise_handle {
@@ -125,6 +134,24 @@ ise_error_t ise_channel(struct ise_handle*dev, unsigned cid)
       return ISE_OK;
 }
 
+/*
+ * There is no batched root table here, so just open the channels one
+ * at a time.
+ */
+ise_error_t ise_channels(struct ise_handle*dev, const unsigned*ids, size_t n)
+{
+      ise_error_t rc = ISE_OK;
+      size_t idx;
+
+      for (idx = 0 ;  idx < n ;  idx += 1) {
+	    rc = ise_channel(dev, ids[idx]);
+	    if (rc != ISE_OK)
+		  break;
+      }
+
+      return rc;
+}
+
 /*
  * Making a frame involves actually making the frame, and mapping it
  * into the address space of this process. If the frame already
@@ -428,6 +455,113 @@ ise_error_t ise_readln(struct ise_handle*dev, unsigned cid,
       return ISE_ERROR;
 }
 
+/*
+ * The tagged requests are written as "<tag>command" lines without
+ * waiting for responses. Responses are read by tag, and lines that
+ * arrive for other tags while waiting are kept in the stash of the
+ * channel, in arrival order, until somebody asks for them.
+ */
+static const char*match_tag(const char*line, const char*tag)
+{
+      size_t len;
+
+      if (tag == 0 || tag[0] == 0)
+	    return line[0] == '<'? 0 : line;
+
+      if (line[0] != '<')
+	    return 0;
+
+      len = strlen(tag);
+      if (strncmp(line+1, tag, len) != 0)
+	    return 0;
+      if (line[1+len] != '>')
+	    return 0;
+
+      return line + len + 2;
+}
+
+static void copy_out(char*buf, size_t nbuf, const char*text)
+{
+      size_t len = strlen(text);
+      if (len >= nbuf)
+	    len = nbuf - 1;
+
+      memcpy(buf, text, len);
+      buf[len] = 0;
+}
+
+ise_error_t ise_request(struct ise_handle*dev, unsigned cid,
+			const char*tag, const char*command)
+{
+      ise_error_t rc;
+      char*line;
+
+      if (tag == 0 || tag[0] == 0)
+	    return ise_writeln(dev, cid, command);
+
+      line = malloc(strlen(tag) + strlen(command) + 3);
+      if (line == 0)
+	    return ISE_ERROR;
+
+      sprintf(line, "<%s>%s", tag, command);
+      rc = ise_writeln(dev, cid, line);
+      free(line);
+
+      return rc;
+}
+
+ise_error_t ise_response(struct ise_handle*dev, unsigned cid,
+			 const char*tag, char*buf, size_t nbuf)
+{
+      struct ise_channel*chn;
+      struct ise_stash**cur;
+      struct ise_stash*tmp;
+      const char*text;
+      char line[4096];
+      ise_error_t rc;
+
+      chn = dev->clist;
+      while (chn && (chn->cid != cid))
+	    chn = chn->next;
+
+      if (chn == 0)
+	    return ISE_NO_CHANNEL;
+      if (nbuf == 0)
+	    return ISE_ERROR;
+
+      for (cur = &chn->stash ;  *cur ;  cur = &(*cur)->next) {
+	    text = match_tag((*cur)->text, tag);
+	    if (text == 0)
+		  continue;
+
+	    copy_out(buf, nbuf, text);
+	    tmp = *cur;
+	    *cur = tmp->next;
+	    free(tmp);
+	    return ISE_OK;
+      }
+
+      for (;;) {
+	    rc = ise_readln(dev, cid, line, sizeof line);
+	    if (rc != ISE_OK)
+		  return rc;
+
+	    text = match_tag(line, tag);
+	    if (text) {
+		  copy_out(buf, nbuf, text);
+		  return ISE_OK;
+	    }
+
+	    tmp = malloc(sizeof (struct ise_stash) + strlen(line));
+	    if (tmp == 0)
+		  return ISE_ERROR;
+	    strcpy(tmp->text, line);
+	    tmp->next = 0;
+	    *cur = tmp;
+	    cur = &tmp->next;
+      }
+}
+
 const char*ise_prom_version(struct ise_handle*dev)
 {
       return dev->version;
@@ -627,6 +761,20 @@ ise_error_t ise_timeout(struct ise_handle*dev, unsigned cid, long read_timeout)
       return ISE_OK;
 }
 
+/*
+ * The Windows driver only takes milliseconds, so round up.
+ */
+ise_error_t ise_timeout_us(struct ise_handle*dev, unsigned cid,
+			   long read_timeout_us)
+{
+      long read_timeout = read_timeout_us;
+      if (read_timeout_us > 0)
+	    read_timeout = read_timeout_us / 1000
+		  + (read_timeout_us % 1000? 1 : 0);
+
+      return ise_timeout(dev, cid, read_timeout);
+}
+
 struct ise_handle* ise_bind(const char*name)
 {
       struct ise_handle*dev;
@@ -902,6 +1050,15 @@ struct ise_handle* ise_open(const char*name)
       return dev;
 }
 
+/*
+ * This driver does not cache the PROM ident, so there is nothing for
+ * a lazy open to save.
+ */
+struct ise_handle* ise_open_lazy(const char*name)
+{
+      return ise_open(name);
+}
+
 void ise_close(struct ise_handle*dev)
 {
       unsigned idx;
@@ -924,6 +1081,11 @@ void ise_close(struct ise_handle*dev)
 	    }
 
 	    CloseHandle(chn->fd);
+	    while (chn->stash) {
+		  struct ise_stash*tmp = chn->stash;
+		  chn->stash = tmp->next;
+		  free(tmp);
+	    }
 	    free(chn);
       }
 
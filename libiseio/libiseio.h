@@ -93,7 +93,8 @@ typedef enum ise_error_code {
       ISE_NO_SCOF = 2,
       ISE_NO_CHANNEL = 3,
       ISE_CHANNEL_BUSY = 4,
-      ISE_CHANNEL_TIMEOUT = 5
+      ISE_CHANNEL_TIMEOUT = 5,
+      ISE_WOULD_BLOCK = 6
 } ise_error_t;
 
 EXTERN const char*ise_error_msg(ise_error_t code);
@@ -112,6 +113,22 @@ EXTERN const char*ise_error_msg(ise_error_t code);
  */
 EXTERN struct ise_handle* ise_open(const char*name);
 
+/*
+ * ise_open_lazy is ise_open for a caller that calls ise_restart
+ * next. It does not reset the board, so the ise_restart is the only
+ * reset on the way up. Until then the board may still be running
+ * whatever it was running before, so the handle must not be used for
+ * anything other than ise_prom_version, ise_restart and ise_close.
+ *
+ * Both ise_open and ise_open_lazy read the PROM ident (for
+ * ise_prom_version) from the board only the first time the board is
+ * opened, and the driver caches it for later opens. If the ident is
+ * not yet cached, ise_open_lazy resets the board to read it. (The
+ * cache is Linux only. ise_open_lazy is the same as ise_open
+ * elsewhere.)
+ */
+EXTERN struct ise_handle* ise_open_lazy(const char*name);
+
 /*
  * ise_bind is a restricted form of ise_open. The handle that is
  * created does not support ise_restart or ise_prom_version, but can
@@ -156,10 +173,48 @@ EXTERN const char*ise_prom_version(struct ise_handle*dev);
  *   WinNT -- . (current working directory), then the contents of the
  *            registry entry System\CurrentControlSet\Services\ise\Firmware.
  *
+ * Under Linux, the driver remembers which firmware image each board
+ * is running, until the board is next reset. If the board is already
+ * running the very same image (same name and contents), ise_restart
+ * closes all the channels and frames of the handle, checks with
+ * ise_heartbeat that the program still answers, and returns without
+ * the reset and download. If the program does not answer, it does
+ * the full reset and download after all. Use ise_open_lazy, which
+ * does not reset the board, to open a board for this. ise_close
+ * resets the board as usual, unless LIBISEIO_KEEP_FIRMWARE is set in
+ * the environment, so set it to keep the program running for the
+ * next process. Set LIBISEIO_FULL_RESTART in the environment to
+ * always reset and download.
+ *
  * The function returns ISE_OK on successful completion.
  */
 EXTERN ise_error_t ise_restart(struct ise_handle*dev, const char*firm);
 
+/*
+ * These bring up several boards at once. Each board is done by its
+ * own worker thread, so the time taken is that of the slowest board,
+ * and not the sum of them all. (Linux only.)
+ *
+ * ise_open_many does ise_open for each of the n names, and if firm is
+ * not NULL, also ise_restart with that firmware. The handles are
+ * written to the devs array, with NULL for each board that could not
+ * be opened. A board that opened but failed the restart still has its
+ * handle in devs, so the caller must ise_close every non-NULL handle.
+ *
+ * ise_restart_many does ise_restart with the same firmware for each
+ * of the n handles. A NULL handle fails with ISE_ERROR.
+ *
+ * If rcs is not NULL, the result for each board is written to rcs,
+ * which has room for n results. The return value is ISE_OK if all the
+ * boards succeeded, or else the first error in the order of the
+ * boards. The failures are also written to the LIBISEIO_LOG log.
+ */
+EXTERN ise_error_t ise_open_many(const char*const*names, unsigned n,
+				 const char*firm, struct ise_handle**devs,
+				 ise_error_t*rcs);
+EXTERN ise_error_t ise_restart_many(struct ise_handle*const*devs, unsigned n,
+				    const char*firm, ise_error_t*rcs);
+
 /*
  * This creates channel number <id> to the device. Once the channel is
  * created, it can be used in the writeln and readln functions
@@ -169,6 +224,18 @@ EXTERN ise_error_t ise_restart(struct ise_handle*dev, const char*firm);
  */
 EXTERN ise_error_t ise_channel(struct ise_handle*dev, unsigned id);
 
+/*
+ * This creates the n channels listed in the ids array. It is the same
+ * as calling ise_channel for each id, but the board is told about all
+ * the new channels at once, so it is much faster when many channels
+ * are needed. If any channel fails, the function stops and returns
+ * the error, but the channels created before the failure remain open.
+ * (The batching is Linux only. Elsewhere, the channels are opened one
+ * at a time.)
+ */
+EXTERN ise_error_t ise_channels(struct ise_handle*dev, const unsigned*ids,
+				size_t n);
+
 /*
  * The writeln and readln functions write and read lines of text
  * to/from a channel. These functions work with ASCII data. When
@@ -189,6 +256,72 @@ EXTERN ise_error_t ise_writeln(struct ise_handle*dev, unsigned channel,
 EXTERN ise_error_t ise_readln(struct ise_handle*dev, unsigned channel,
 			      char*buf, size_t nbuf);
 
+/*
+ * ise_writeln_batch writes the nlines lines of text in the lines
+ * array to the channel, as if by calling ise_writeln for each, but
+ * with a single write and a single flush. This is much faster when
+ * there are many commands to send at once.
+ *
+ * ise_writev writes raw data from the iovcnt segments of the iov
+ * array (see writev(2)) to the channel, then flushes once. The data
+ * is sent as is, with no EOLs added. (Linux only.)
+ */
+struct iovec;
+EXTERN ise_error_t ise_writeln_batch(struct ise_handle*dev, unsigned channel,
+				     const char*const*lines, size_t nlines);
+EXTERN ise_error_t ise_writev(struct ise_handle*dev, unsigned channel,
+			      const struct iovec*iov, int iovcnt);
+
+/*
+ * Many firmware commands accept a "<tag>" prefix, and the firmware
+ * then starts each line of the response with the same "<tag>". The
+ * request and response functions use the tags to keep many commands
+ * in flight on a channel at once, instead of paying a round trip per
+ * command.
+ *
+ * ise_request writes the line "<tag>command" to the channel and
+ * returns without waiting for any response. A null or empty tag
+ * writes the command without a tag.
+ *
+ * ise_response reads the next response line for the tag, strips the
+ * "<tag>" and returns the rest of the line in buf. Lines for other
+ * tags that arrive first are kept by the library, and returned by
+ * later ise_response calls for those tags. A null or empty tag gets
+ * the next line that has no tag. ise_response is subject to
+ * ise_timeout like ise_readln.
+ *
+ * Do not mix ise_readln with these functions on the same channel, as
+ * ise_readln does not see the kept lines.
+ */
+EXTERN ise_error_t ise_request(struct ise_handle*dev, unsigned channel,
+			       const char*tag, const char*command);
+EXTERN ise_error_t ise_response(struct ise_handle*dev, unsigned channel,
+				const char*tag, char*buf, size_t nbuf);
+
+/*
+ * The write_msg and read_msg functions send and receive binary
+ * messages. Each message on the channel is a 4 byte little-endian
+ * length followed by that many bytes of payload. The firmware must
+ * use the same framing on the channel. These are faster then text
+ * lines for high rate traffic, because the payload is not scanned
+ * for EOLs.
+ *
+ * ise_write_msg sends the header and payload together, and flushes
+ * the channel once. A payload too large for the 4 byte length is
+ * refused with ISE_ERROR.
+ *
+ * ise_read_msg waits for a complete message and returns in *data and
+ * *ndata a view of the payload. The view is usually into the channel
+ * buffer, so there is no copy. It is only valid until the next read
+ * of any kind on the channel. Reads are subject to ise_timeout. If a
+ * timeout happens before the whole message arrives, the channel is
+ * left intact unless the message is larger then 4K. (Linux only.)
+ */
+EXTERN ise_error_t ise_write_msg(struct ise_handle*dev, unsigned channel,
+				 const void*data, size_t ndata);
+EXTERN ise_error_t ise_read_msg(struct ise_handle*dev, unsigned channel,
+				const void**data, size_t*ndata);
+
 /*
  * Normally, ise_readln will wait as long as necessary (potentially
  * forever) to get the entire line. Use this function to set blocking
@@ -211,6 +344,99 @@ EXTERN ise_error_t ise_readln(struct ise_handle*dev, unsigned channel,
 EXTERN ise_error_t ise_timeout(struct ise_handle*dev, unsigned channel,
 			       long read_timeout);
 
+/*
+ * ise_timeout_us is the same as ise_timeout, but the timeout is given
+ * in microseconds. Under Linux, the driver times short timeouts
+ * precisely, instead of rounding them up to the scheduler tick. With
+ * an older driver, or under Windows, the timeout is rounded up to
+ * whole milliseconds.
+ */
+EXTERN ise_error_t ise_timeout_us(struct ise_handle*dev, unsigned channel,
+				  long read_timeout_us);
+
+/*
+ * A channel is normally created with a ring of 4 buffers of 4K in
+ * each direction. That is plenty for commands and responses, but
+ * channels that carry bulk data run faster with deeper rings and
+ * larger buffers. Use this function to request a ring of *depth
+ * buffers, each *buf_size bytes, for the given open channel. The
+ * firmware must agree to the ring, so when the function returns the
+ * depth and buf_size are replaced with the values actually in use. If
+ * the firmware does not support rings, they are left at 4 and 4K.
+ *
+ * The channel must be idle, so call this right after ise_channel and
+ * before any data is written or read. (Linux only.)
+ */
+EXTERN ise_error_t ise_channel_ring(struct ise_handle*dev, unsigned channel,
+				    unsigned*depth, size_t*buf_size);
+
+/*
+ * These functions give direct access to the ring buffers of a channel
+ * that was given a ring by ise_channel_ring. This avoids copying bulk
+ * data through ise_write or ise_readln, and should not be mixed with
+ * them on the same channel. (Linux only.)
+ *
+ * ise_ring_out_buffer returns in *buf the next out buffer to fill,
+ * and in *nbuf its size. Fill the buffer with up to *nbuf bytes, then
+ * call ise_ring_out_publish with the number of bytes to send them to
+ * the board. The publish blocks only if the ring is full.
+ *
+ * ise_ring_in_buffer waits for data from the board, subject to the
+ * ise_timeout setting of the channel, and returns in *buf and *count
+ * the next in buffer and the number of bytes in it. The buffer stays
+ * valid until it is returned to the board with ise_ring_in_release.
+ * If the wait times out, the function returns ISE_CHANNEL_TIMEOUT.
+ */
+EXTERN ise_error_t ise_ring_out_buffer(struct ise_handle*dev, unsigned channel,
+				       void**buf, size_t*nbuf);
+EXTERN ise_error_t ise_ring_out_publish(struct ise_handle*dev, unsigned channel,
+					size_t count);
+EXTERN ise_error_t ise_ring_in_buffer(struct ise_handle*dev, unsigned channel,
+				      const void**buf, size_t*count);
+EXTERN ise_error_t ise_ring_in_release(struct ise_handle*dev, unsigned channel);
+
+
+/*
+ * -- Asynchronous I/O -- (Linux only.)
+ *
+ * These functions let a single thread serve many channels without
+ * blocking on any of them. ise_readln_async and ise_writeln_async
+ * queue a readln or writeln on a channel and return at once. The
+ * operations complete in order, and each completion calls the given
+ * callback with the cookie. A read callback gets the line of text
+ * with the EOL stripped, and the text is only valid until the
+ * callback returns. A write callback is called when the line is
+ * passed to the board.
+ *
+ * Completions happen only within ise_async_process, which waits up
+ * to timeout ms (ISE_TIMEOUT_OFF waits forever, 0 polls) for channels
+ * to become ready, then runs the callbacks of all the operations that
+ * complete. It returns ISE_CHANNEL_TIMEOUT if nothing completed.
+ *
+ * ise_event_fd returns a file descriptor that polls readable when
+ * ise_async_process has work to do, so that the application can put
+ * it in its own select/poll/epoll loop. Do not read from it.
+ *
+ * Once an asynchronous operation is queued on a channel, the channel
+ * is in non-blocking mode, so do not use ise_readln or ise_writeln on
+ * it. The callbacks may queue more operations, but must not close the
+ * handle. If a channel fails, the pending operations complete with
+ * the error. Pending operations are discarded without callbacks when
+ * the handle is closed.
+ */
+typedef void (*ise_readln_cb)(struct ise_handle*dev, unsigned channel,
+			      ise_error_t rc, const char*text, void*cookie);
+typedef void (*ise_writeln_cb)(struct ise_handle*dev, unsigned channel,
+			       ise_error_t rc, void*cookie);
+
+EXTERN ise_error_t ise_readln_async(struct ise_handle*dev, unsigned channel,
+				    ise_readln_cb fun, void*cookie);
+EXTERN ise_error_t ise_writeln_async(struct ise_handle*dev, unsigned channel,
+				     const char*data,
+				     ise_writeln_cb fun, void*cookie);
+EXTERN ise_error_t ise_async_process(struct ise_handle*dev, long timeout);
+EXTERN int ise_event_fd(struct ise_handle*dev);
+
 
 /*
  * This function creates and maps a frame. The frame is a chunk of
@@ -220,26 +446,145 @@ EXTERN ise_error_t ise_timeout(struct ise_handle*dev, unsigned channel,
  * frame. When the function returns, the siz is replaced with the
  * actual size of the frame, in bytes. 
  *
+ * Frame ids 0-15 are for frames of up to 256Meg. On Linux, frame ids
+ * 16 up to ISE_FRAME_MAX-1 are also available, for frames of up to
+ * 64Gig, if the board firmware supports them. Frame 15 cannot be used
+ * at the same time as frames 16 and up.
+ *
  * The return value is the base address of the frame, or NULL if there
  * is a problem making the frame.
  *
  * The ise_delete_frame method releases a frame and clears up any
  * resources the frame may have consumed.
  */
+# define ISE_FRAME_MAX 256
 EXTERN void* ise_make_frame(struct ise_handle*dev, unsigned id, size_t*siz);
 
 EXTERN void  ise_delete_frame(struct ise_handle*dev, unsigned id);
 
+/*
+ * The ise_frame_prefault function sets whether the frame is to be
+ * mapped all at once when it is made, instead of one page at a time
+ * as the pages are first touched. Call it before ise_make_frame for
+ * the frame. Large frames that are read soon after they are made
+ * will take many fewer page faults this way.
+ *
+ * The ise_frame_faults function returns the number of page faults
+ * the driver has taken so far for the frame, or -1 if that is not
+ * known. This is useful for checking the effect of prefaulting.
+ *
+ * (Linux only.)
+ */
+EXTERN ise_error_t ise_frame_prefault(struct ise_handle*dev, unsigned id,
+				      int flag);
+EXTERN long ise_frame_faults(struct ise_handle*dev, unsigned id);
+
+/*
+ * Frame events let the application wait for the board to finish
+ * frames without polling the board with commands. The board counts,
+ * for each frame id, the number of times it has finished that frame.
+ *
+ * ise_frame_event_fd turns frame events on and returns a file
+ * descriptor that polls readable when the board has finished a frame
+ * since the last ise_frame_event_read. Put it in a select/poll/epoll
+ * loop, but do not read from it directly. It returns -1 if the board
+ * or driver does not support frame events. Frame events are turned
+ * off when the board is restarted, so call it again after
+ * ise_restart.
+ *
+ * ise_frame_event_read gets the finished counts for frames 0 to
+ * nframes-1 into done_seq. A frame is finished again when its count
+ * changes. It does not block, and returns ISE_WOULD_BLOCK if no frame
+ * is finished since the last read.
+ *
+ * (Linux only.)
+ */
+EXTERN int ise_frame_event_fd(struct ise_handle*dev);
+EXTERN ise_error_t ise_frame_event_read(struct ise_handle*dev,
+					unsigned*done_seq, unsigned nframes);
+
+/*
+ * ise_heartbeat checks that the board is alive without using any
+ * channels, so it does not disturb a program that is using the
+ * board. It may be called with a handle from ise_bind.
+ *
+ * If the board is running firmware, the driver pings the firmware
+ * through the board status registers and waits up to timeout_ms for
+ * the answer. The firmware must support the heartbeat (see
+ * protocol.txt). If the board is in its bootprom, there is no ping,
+ * and bit 0 of the status is set. If status is not NULL, it gets the
+ * 16bit status word of the board. If latency_us is not NULL, it gets
+ * the time the check took, in microseconds.
+ *
+ * The function returns ISE_OK if the firmware answered or the board
+ * is in the bootprom, ISE_CHANNEL_TIMEOUT if the firmware did not
+ * answer in time, or ISE_ERROR if the check is not supported.
+ *
+ * (Linux only.)
+ */
+EXTERN ise_error_t ise_heartbeat(struct ise_handle*dev, unsigned timeout_ms,
+				 unsigned*status, unsigned long*latency_us);
+
+/*
+ * A frame ring rotates a set of frames between the board and the
+ * host, so that the board fills one frame while the host works on
+ * another. ise_frame_ring_open makes nframes frames of the given
+ * size, with frame ids starting at first_id, and for each frame sends
+ * the fill command "<command> <id>" to the channel as a tagged
+ * request (see ise_request). The board answers each fill command
+ * when the frame is filled.
+ *
+ * ise_frame_ring_acquire waits for the next filled frame, in the
+ * order the fill commands were sent, and fills in the ise_frame_buf
+ * with the frame and the text of the response (without the tag). The
+ * wait is subject to ise_timeout on the channel. The host owns the
+ * frame until it passes it to ise_frame_ring_release, which hands it
+ * back to the board with another fill command.
+ *
+ * ise_frame_ring_close waits for the fill commands that are still
+ * outstanding, and deletes the frames.
+ *
+ * The ring uses ise_request/ise_response on the channel, so the same
+ * rules about mixing with ise_readln apply. (Linux only.)
+ */
+struct ise_frame_ring;
+struct ise_frame_buf {
+      unsigned id;
+      void*base;
+      size_t size;
+      const char*text;
+};
+
+EXTERN struct ise_frame_ring* ise_frame_ring_open(struct ise_handle*dev,
+						  unsigned channel,
+						  unsigned first_id,
+						  unsigned nframes,
+						  size_t size,
+						  const char*command);
+EXTERN ise_error_t ise_frame_ring_acquire(struct ise_frame_ring*ring,
+					  struct ise_frame_buf*buf);
+EXTERN ise_error_t ise_frame_ring_release(struct ise_frame_ring*ring,
+					  const struct ise_frame_buf*buf);
+EXTERN void ise_frame_ring_close(struct ise_frame_ring*ring);
+
 
 /*
  * Clean up and close the ISE board. If there are any channels or frames
  * remaining, they are deleted/closed. The ISE board is reset, and the
  * ise_handle object is released.
+ *
+ * Under Linux, if LIBISEIO_KEEP_FIRMWARE is set in the environment,
+ * then a board that is running a program from ise_restart is not
+ * reset, so that the next ise_restart of the same image, even from
+ * another process, can skip the reset and download (see ise_restart).
  */
 EXTERN void ise_close(struct ise_handle*dev);
 
 /*
  * This is a function for sending update packages to the jse board.
+ * The board must be in the PROM monitor, so use a handle from
+ * ise_open, not ise_open_lazy. (Under Linux, if the board is running a
+ * program from ise_restart, this resets the board first.)
  */
 EXTERN ise_error_t ise_send_package(struct ise_handle*dev, const char*name,
 				    const void*pkg_data, size_t ndata,
@@ -27,6 +27,16 @@
 
 struct channel_data __libiseio_channels[256];
 
+void __libiseio_channel_compact(struct channel_data*chp)
+{
+      if (chp->buf_ptr == 0)
+	    return;
+
+      memmove(chp->buf, chp->buf+chp->buf_ptr, chp->buf_fil-chp->buf_ptr);
+      chp->buf_fil -= chp->buf_ptr;
+      chp->buf_ptr = 0;
+}
+
 int ise_plug_readln(int chn, char*buf, size_t nbuf, long udelay)
 {
       struct channel_data*chp = __libiseio_channels + chn;
@@ -53,7 +63,8 @@ int ise_plug_readln(int chn, char*buf, size_t nbuf, long udelay)
 
 	/* Wait for a '\n' to show up in the input stream. If the line
 	   is not complete, then keep waiting. */
-      while ( (nl = strchr(chp->buf, '\n')) == 0 ) {
+      while ( (nl = memchr(chp->buf+chp->buf_ptr, '\n',
+			   chp->buf_fil-chp->buf_ptr)) == 0 ) {
 	    if (udelay == 0) {
 		    /* User asked not to wait. */
 		  break;
@@ -68,22 +79,25 @@ int ise_plug_readln(int chn, char*buf, size_t nbuf, long udelay)
 	    }
       }
 
-      if (nl && (*nl == '\n')) {
+      if (nl) {
+	    char*line = chp->buf + chp->buf_ptr;
+	    size_t len = nl - line;
+	    size_t trans = len < nbuf? len : nbuf-1;
+
 	    *nl = 0;
 	    if (__libiseio_plug_log)
 		  fprintf(__libiseio_plug_log, "ise_plug_readln: "
-			  "GOT \"%s\"\n", chp->buf);
+			  "GOT \"%s\"\n", line);
 
-	    strncpy(buf, chp->buf, nbuf);
-	    buf[nbuf-1] = 0;
-	    rc = nl - chp->buf;
+	    memcpy(buf, line, trans);
+	    buf[trans] = 0;
+	    rc = len;
 
-	    nl += 1;
-	    if (nl-chp->buf >= chp->buf_fil) {
+	      /* Step past the line and its EOL. */
+	    chp->buf_ptr += len + 1;
+	    if (chp->buf_ptr >= chp->buf_fil) {
+		  chp->buf_ptr = 0;
 		  chp->buf_fil = 0;
-	    } else {
-		  memmove(chp->buf, nl, chp->buf_fil - (nl-chp->buf)+1);
-		  chp->buf_fil -= nl - chp->buf;
 	    }
 
       } else {
@@ -74,6 +74,7 @@ static void open_fun(int argc, const char*argv[])
 	    close(__libiseio_channels[chn].fd);
 
       __libiseio_channels[chn].fd = fd;
+      __libiseio_channels[chn].buf_ptr = 0;
       __libiseio_channels[chn].buf_fil = 0;
 
       if (__libiseio_plug_log)
@@ -112,6 +113,7 @@ static void frame_fun(int argc, const char*argv[])
 
       int frm = strtol(argv[1],0,10);
       size_t len = strtoul(argv[2],0,0);
+      assert(frm >= 0 && frm < PLUG_FRAME_MAX);
 
       int fd = open(argv[3],O_RDWR,0);
       assert(fd >= 0);
@@ -22,14 +22,14 @@
 # include  "priv.h"
 
 
-struct frame_data __libiseio_plug_frames [16];
+struct frame_data __libiseio_plug_frames [PLUG_FRAME_MAX];
 
 
 const struct ise_plug_frame*ise_plug_frame_lock(int frm)
 {
       if (frm < 0)
 	    return 0;
-      if (frm >= 16)
+      if (frm >= PLUG_FRAME_MAX)
 	    return 0;
 
       struct frame_data*fdp = __libiseio_plug_frames+frm;
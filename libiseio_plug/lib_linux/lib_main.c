@@ -43,7 +43,15 @@ static void process_port(int port_fd)
       size_t buf_fil = 0;
 
       int rc = read(port_fd, buf+buf_fil, sizeof buf - buf_fil - 1);
-      if (rc <= 0)
+      if (rc == 0) {
+	      /* The host closed its end of the port, so there is
+		 nobody left to serve. */
+	    if (__libiseio_plug_log)
+		  fprintf(__libiseio_plug_log, "ise_plug_main: "
+			  "Host closed the port, exit.\n");
+	    exit(0);
+      }
+      if (rc < 0)
 	    return;
 
       buf[buf_fil+rc] = 0;
@@ -67,6 +75,9 @@ static void collect_channel_data(int chn)
 
       pthread_mutex_lock(&chp->sync);
 
+      if (chp->buf_fil + 1 >= sizeof chp->buf)
+	    __libiseio_channel_compact(chp);
+
       int rc = read(chp->fd, chp->buf+chp->buf_fil,
 		    sizeof chp->buf - chp->buf_fil - 1);
       if (rc > 0) {
@@ -88,9 +99,10 @@ static void process_254(void)
 
       pthread_mutex_lock(&chp->sync);
 
-      while ( (nl = strchr(chp->buf, '\n')) ) {
+      while ( (nl = memchr(chp->buf+chp->buf_ptr, '\n',
+			   chp->buf_fil-chp->buf_ptr)) ) {
 	    char res[1024];
-	    char*line = chp->buf;
+	    char*line = chp->buf + chp->buf_ptr;
 	    *nl++ = 0;
 
 	    if (line[0] == 'i') {
@@ -102,8 +114,12 @@ static void process_254(void)
 
 	    int rc = write(chp->fd, res, strlen(res));
 
-	    memmove(chp->buf, nl, chp->buf_fil - (nl-chp->buf)+1);
-	    chp->buf_fil -= nl-chp->buf;
+	    chp->buf_ptr = nl - chp->buf;
+      }
+
+      if (chp->buf_ptr >= chp->buf_fil) {
+	    chp->buf_ptr = 0;
+	    chp->buf_fil = 0;
       }
 
       pthread_mutex_unlock(&chp->sync);
@@ -130,12 +146,13 @@ int ise_plug_main(int argc, char*argv[])
 
       for (idx = 0 ; idx < 256 ; idx += 1) {
 	    __libiseio_channels[idx].fd = -1;
+	    __libiseio_channels[idx].buf_ptr = 0;
 	    __libiseio_channels[idx].buf_fil = 0;
 	    pthread_mutex_init(&__libiseio_channels[idx].sync, 0);
 	    pthread_cond_init(&__libiseio_channels[idx].data_arrival, 0);
       }
 
-      for (idx = 0 ; idx < 16 ; idx += 1) {
+      for (idx = 0 ; idx < PLUG_FRAME_MAX ; idx += 1) {
 	    struct frame_data*fdp = __libiseio_plug_frames+idx;
 	    fdp->base_data.id   = idx;
 	    fdp->base_data.base = 0;
@@ -172,8 +189,13 @@ int ise_plug_main(int argc, char*argv[])
 		  continue;
 	    assert(rc >= 0);
 
-	    if (FD_ISSET(__libiseio_plug_isex, &readfds))
+	      /* The port commands may close a channel and open another
+		 that reuses its fd, so the rest of readfds may be stale
+		 after them. Select again before reading any channel. */
+	    if (FD_ISSET(__libiseio_plug_isex, &readfds)) {
 		  process_port(__libiseio_plug_isex);
+		  continue;
+	    }
 
 	    for (idx = 0 ; idx < 256 ; idx += 1) {
 		  if (__libiseio_channels[idx].fd < 0)
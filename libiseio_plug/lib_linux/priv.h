@@ -37,7 +37,11 @@ extern int __libiseio_plug_isex;
  */
 struct channel_data {
       int fd;
+	/* The unread data is buf[buf_ptr] up to buf[buf_fil]. Lines
+	   are taken from the front by advancing buf_ptr, and the data
+	   is only moved down when there is no room left to read. */
       char buf[8*1024];
+      size_t buf_ptr;
       size_t buf_fil;
 
       pthread_mutex_t sync;
@@ -47,15 +51,23 @@ struct channel_data {
 extern struct channel_data __libiseio_channels [256];
 
 /*
- * Information about open frames
+ * Make room at the end of the channel buffer by moving the unread
+ * data down to the front. Call with the channel sync held.
  */
+extern void __libiseio_channel_compact(struct channel_data*chp);
+
+/*
+ * Information about open frames. The host may use frame ids up to
+ * ISE_FRAME_MAX from libiseio.h.
+ */
+# define PLUG_FRAME_MAX 256
 struct frame_data {
       struct ise_plug_frame base_data;
 
       pthread_mutex_t sync;
 };
 
-extern struct frame_data __libiseio_plug_frames [16];
+extern struct frame_data __libiseio_plug_frames [PLUG_FRAME_MAX];
 
 extern void __libiseio_process_command(char*line);
 
@@ -79,6 +79,49 @@ struct frame_table {
       __u32 page[0];
 };
 
+/*
+ * The frame directory holds frame tables for frames beyond the 16
+ * slots of the root table. When the host has such frames, it puts
+ * the directory in root table frame slot 15 with FRAME_DIR_MAGIC as
+ * the slot magic number, and slot 15 is not available for a frame of
+ * its own. Entry N of the directory is frame 16+N.
+ *
+ * The ISE board writes FRAME_DIR_MAGIC into the accept field before
+ * it acknowledges the root table that carries the directory. If the
+ * field is still 0 after the handshake, the board does not know about
+ * frame directories, and the host takes the directory away again.
+ */
+# define FRAME_DIR_MAGIC 0x4eaffaaf
+# define FRAME_DIR_SLOT 15
+# define FRAME_DIR_FRAMES 240
+struct frame_directory {
+      __u32 magic;
+      __u32 self;
+      __u32 count;
+      __u32 accept;
+      __u32 events;
+      __u32 reserved[3];
+
+      struct {
+	    __u32 ptr;
+	    __u32 magic;
+      } frame_table[FRAME_DIR_FRAMES];
+};
+
+/*
+ * The frame events page is where the ISE board reports finished
+ * frames. The host puts its bus address in the events field of the
+ * frame directory. The board increments done_seq[N] when it finishes
+ * writing frame N, then rings the frame done bell (OUT BELL 3).
+ */
+# define FRAME_EVENT_MAGIC 0x5eaffaaf
+# define FRAME_EVENT_FRAMES 256
+struct frame_events {
+      __u32 magic;
+      __u32 self;
+      __u32 done_seq[FRAME_EVENT_FRAMES];
+};
+
 /*
  * The channel table is known by the ISE board to have this
  * structure. See the README.txt file for a description of these
@@ -98,6 +141,11 @@ struct frame_table {
 # define CHANNEL_IBUFS 4
 # define CHANNEL_OBUFS 4
 # define CHANNEL_TABLE_MAGIC 0x5eefeadf
+struct channel_buf {
+      __u32 ptr;
+      __u32 count;
+};
+
 struct channel_table {
       __u32 magic;
       __u32 self;
@@ -111,10 +159,44 @@ struct channel_table {
       __u32 first_in_idx;
       __u32 next_in_idx;
 
-      struct {
-	    __u32 ptr;
-	    __u32 count;
-      } out[CHANNEL_OBUFS], in[CHANNEL_IBUFS];
+      struct channel_buf out[CHANNEL_OBUFS], in[CHANNEL_IBUFS];
+};
+
+/*
+ * The ring channel table is a variant of the channel table with a
+ * ring depth and buffer size negotiated per channel. The header
+ * through next_in_idx is identical to the fixed channel table. The
+ * obufs and ibufs fields give the number of out and in buffers, and
+ * the buf array holds the out buffers followed by the in buffers. All
+ * the buffers are buf_size bytes, which is a multiple of 4K.
+ *
+ * The ISE board writes CHANNEL_TABLE_MAGIC2 into the accept field
+ * before it acknowledges the root table that first carries this
+ * table. If the field is still 0 after the root table handshake, the
+ * board does not understand ring tables and the driver falls back to
+ * the fixed table.
+ */
+# define CHANNEL_TABLE_MAGIC2 0x6eefeadf
+# define CHANNEL_RING_MAX 128
+struct channel_table2 {
+      __u32 magic;
+      __u32 self;
+      __u32 frame;
+
+      __u32 reserved;
+
+      __u32 first_out_idx;
+      __u32 next_out_idx;
+
+      __u32 first_in_idx;
+      __u32 next_in_idx;
+
+      __u32 obufs;
+      __u32 ibufs;
+      __u32 buf_size;
+      __u32 accept;
+
+      struct channel_buf buf[0];
 };
 
 # define CHANNEL_IN_EMPTY(x) ((x)->table->first_in_idx == (x)->table->next_in_idx)
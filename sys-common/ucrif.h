@@ -61,6 +61,12 @@
  * UCR_NONBLOCK under NT) read will return 0 bytes if there are no
  * bytes ready to be read.
  *
+ * Under linux, non-blocking mode also applies to writes. A write
+ * writes as many bytes as fit in the write ring and returns the
+ * count, or fails with EAGAIN if the ring is full. A UCR_FLUSH also
+ * fails with EAGAIN if the ring has no room for the pending
+ * buffer. The channel polls writable when the ring has room.
+ *
  * Finally, closing a channel causes the channel and host buffer
  * resources to be removed. The close does NOT flush the buffers. It
  * is recommended that a UCR_SYNC preceed a close to prevend a loss of
@@ -76,8 +82,9 @@
  * confusing the driver.
  *
  * NOTE ON SELECT: The driver does in fact support the select system
- * call under Linux, but for input data only. NT does not have a
- * general purpose select system call, use overlapped IO instead.
+ * call under Linux. It reports input data, and room in the output
+ * ring. NT does not have a general purpose select system call, use
+ * overlapped IO instead.
  *
  * NOTE ON Windows NT: The IOCTL codes are compatible with Windows NT
  * encoding using BUFFERED I/O of the parameters. The FILE_DEVICE type
@@ -111,6 +118,67 @@
  */
 # define UCR_CHANNEL UCR_(0,1)
 
+#if defined(linux)
+/*
+ * Use this ioctl to negotiate the ring depth and buffer size of the
+ * current channel. The argument points to a ucr_channel_ring_s
+ * structure, where depth is the number of in and the number of out
+ * buffers, and buf_size is the size of each buffer in bytes. The
+ * buf_size is rounded up to a multiple of the page size.
+ *
+ * The driver offers the ring to the target board, and writes back
+ * into the structure the depth and buf_size that are actually in
+ * use. A target that does not understand ring tables leaves the
+ * channel with the fixed 4 buffers of a page each, and that is
+ * reported back. The ioctl returns EBUSY if the channel has data in
+ * flight, and EINVAL if the depth or buf_size are out of range.
+ */
+struct ucr_channel_ring_s {
+      unsigned depth;
+      unsigned buf_size;
+};
+# define UCR_CHANNEL_RING UCR_(UCR_READFLAG|UCR_WRITEFLAG,7)
+# define UCR_CHANNEL_RING_MAX_DEPTH 128
+# define UCR_CHANNEL_RING_MAX_BUF   (256*1024)
+
+/*
+ * A channel with a ring table (see UCR_CHANNEL_RING) can also be
+ * mapped into the process, so that the application fills and drains
+ * the channel buffers in place instead of copying through read and
+ * write. There are two regions that are mapped through the channel
+ * file descriptor:
+ *
+ *   UCR_RING_MMAP_TABLE
+ *      The channel_table2 (see ise_tables.h) of the channel. This is
+ *      a single page and can only be mapped read-only. It has the
+ *      ring indices and the buffer counts.
+ *
+ *   UCR_RING_MMAP_DATA
+ *      The channel buffers, each buf_size bytes. The out buffers come
+ *      first, followed by the in buffers, so in buffer N is at offset
+ *      (depth+N)*buf_size within the region.
+ *
+ * The application writes into the out buffer at next_out_idx, then
+ * uses UCR_RING_PRODUCE with the byte count to pass it to the target
+ * board. That blocks only if the ring is full. For input,
+ * UCR_RING_WAIT blocks until an in buffer is ready, subject to the
+ * UCRX_TIMEOUT setting, and returns the number
+ * of ready in buffers. The application reads the buffer at
+ * first_in_idx and returns it to the target with UCR_RING_CONSUME,
+ * whose argument is the number of buffers to release.
+ *
+ * The ring geometry cannot be changed while it is mapped. Partial
+ * read or write data must be drained or flushed before these
+ * controls are used, or they return EBUSY. Poll reports POLLIN when
+ * an in buffer is ready and POLLOUT when the out ring has room.
+ */
+# define UCR_RING_MMAP_TABLE 0x100000000ULL
+# define UCR_RING_MMAP_DATA  0x200000000ULL
+# define UCR_RING_PRODUCE UCR_(UCR_WRITEFLAG,8)
+# define UCR_RING_CONSUME UCR_(UCR_WRITEFLAG,9)
+# define UCR_RING_WAIT    UCR_(0,13)
+#endif
+
 /*
  * Use this to send an attention signal to the uCR target. The single
  * argument is sent to the target as an argument to the attention
@@ -135,7 +203,9 @@
 #if !defined(WINNT) && !defined(_WIN32)
 /*
  * The driver can manage up to 16 frames, each no larger then
- * 256Meg. Use UCR_MAKE_FRAME to create a frame with the given size.
+ * 256Meg, with UCR_MAKE_FRAME. (See UCR_MAKE_FRAME64 below for more
+ * and bigger frames.) Use UCR_MAKE_FRAME to create a frame with the
+ * given size.
  * The argument is of the form 0xfsssssss where f is the frame
  * identifier and s is the size, in bytes.
  *
@@ -180,6 +250,50 @@
 # define UCR_MAKE_FRAME UCR_(0,4)
 # define UCR_FREE_FRAME UCR_(0,5)
 /* # define UCR_SEND_FRAME UCR_(0,6) */
+
+/*
+ * Frames 16 and up are made with UCR_MAKE_FRAME64, which is not
+ * limited to 256Meg. The argument points to a ucr_frame64_s
+ * structure with the frame id and the requested size, and the
+ * driver writes the actual size back into the structure. Frames
+ * 0-15 may be made this way too, but are still limited to 256Meg.
+ * UCR_FREE_FRAME64 takes the frame id as its argument.
+ *
+ * Frames 16 and up are kept in a frame directory that takes the
+ * place of frame 15 in the root table, so frame 15 and the frames
+ * past it cannot be in use at the same time. If frame 15 exists,
+ * making frame 16 or up returns EBUSY, and if the board does not
+ * understand frame directories it returns EOPNOTSUPP.
+ *
+ * The frame is mapped through any channel at offset
+ * UCR_FRAME64_MMAP(id), which is above the channel ring offsets.
+ */
+struct ucr_frame64_s {
+      unsigned id;
+      unsigned reserved;
+      unsigned long long size;
+};
+# define UCR_MAKE_FRAME64 UCR_(UCR_READFLAG|UCR_WRITEFLAG,16)
+# define UCR_FREE_FRAME64 UCR_(UCR_WRITEFLAG,17)
+# define UCR_FRAME_MAX 256
+# define UCR_FRAME64_MMAP(id) ((unsigned long long)((id)-15) << 36)
+
+/*
+ * Normally the pages of a mapped frame are mapped into the process
+ * one page (or chunk) at a time as they are first touched, and each
+ * of those is a page fault. UCR_FRAME_PREFAULT sets a flag for the
+ * frame that causes later mmaps of the frame to map the whole range
+ * up front, so that there are no faults at all. The argument is of
+ * the form (id<<8)|p where id is the frame identifier and p is 1 to
+ * set the flag and 0 to clear it. The frame must exist, and the
+ * flag is forgotten when the frame is freed. Prefaulted mappings
+ * must be shared (or read-only) mappings.
+ *
+ * UCR_FRAME_FAULTS takes the frame id as its argument and returns
+ * the number of page faults taken so far for the frame.
+ */
+# define UCR_FRAME_PREFAULT UCR_(UCR_WRITEFLAG,14)
+# define UCR_FRAME_FAULTS   UCR_(UCR_READFLAG,15)
 #endif
 #endif
 
@@ -271,6 +385,38 @@ struct IsexMmapInfo {
 
 # define UCRX_RUN_PROGRAM UCRX_(0,1)
 
+/*
+ * UCRX_RUN_PROGRAM_WAIT
+ * This is the same as UCRX_RUN_PROGRAM, but if the board is not yet
+ * ready to run the program, it waits for the board to become ready
+ * instead of failing with EAGAIN. The argument is the maximum time
+ * to wait, in milliseconds, and if the board is not ready by then,
+ * the ioctl fails with ETIMEDOUT. (Linux only.)
+ */
+# define UCRX_RUN_PROGRAM_WAIT UCRX_(0,16)
+
+/*
+ * UCRX_HEARTBEAT
+ * Check that the board is alive, without using any channels. If the
+ * board is running firmware, the driver pings it through the status
+ * registers and waits up to timeout milliseconds for the echo. If the
+ * board is in the bootprom, there is no ping, and the BOOTPROM flag
+ * is set instead. Either way, status gets the low 16 bits of the
+ * board status register, and bells the count of status bells from
+ * the board since the driver was loaded. If the firmware does not
+ * echo in time, the structure is still filled in, but the ioctl fails
+ * with ETIMEDOUT. (Linux only.)
+ */
+# define UCRX_HEARTBEAT_ANSWERED 0x0001
+# define UCRX_HEARTBEAT_BOOTPROM 0x0002
+struct ucrx_heartbeat_s {
+      unsigned timeout;
+      unsigned status;
+      unsigned flags;
+      unsigned long bells;
+};
+# define UCRX_HEARTBEAT UCRX_(0,17)
+
 # define UCRX_DIAGNOSE UCRX_(0,2)
 
 /*
@@ -304,6 +450,96 @@ struct ucrx_timeout_s {
 };
 # define UCRX_TIMEOUT UCRX_(0,12)
 
+/*
+ * UCRX_TIMEOUT_US
+ * This is the same as UCRX_TIMEOUT, but the timeout is given in
+ * microseconds. The driver uses a high resolution timer where the
+ * kernel has them, so short timeouts are not rounded up to the
+ * scheduler tick. (Linux only.)
+ */
+struct ucrx_timeout_us_s {
+      unsigned short id;
+      long read_timeout_us;
+};
+# define UCRX_TIMEOUT_US UCRX_(0,18)
+
+/*
+ * UCRX_ROOT_BATCH
+ * Every channel open and UCR_CHANNEL switch normally sends a new root
+ * table to the board, and waits for the board to acknowledge it. An
+ * application that opens many channels can instead open a batch with
+ * UCRX_ROOT_BATCH_BEGIN, open and switch its channels, and then use
+ * UCRX_ROOT_BATCH_COMMIT to send all the changes to the board in a
+ * single root table.
+ *
+ * Channels opened in a batch do not reach the board until the batch
+ * is committed. Closing a channel, changing a channel ring, making or
+ * freeing a frame, or closing the control device that began the
+ * batch commits the batch implicitly. The batch belongs to the
+ * control device open and process that began it. Channels that other
+ * processes open are not added to it, but commit it first, and a
+ * commit through another open of the control device does nothing.
+ * (Linux only.)
+ */
+# define UCRX_ROOT_BATCH UCRX_(0,5)
+# define UCRX_ROOT_BATCH_COMMIT 0
+# define UCRX_ROOT_BATCH_BEGIN  1
+
+/*
+ * UCRX_FRAME_EVENTS
+ * With an argument of 1, this asks the board to report finished
+ * frames, and with 0 it stops the reports. The ioctl fails with
+ * EOPNOTSUPP if the board firmware does not accept the frame
+ * directory, and with EBUSY if frame 15 is in use.
+ *
+ * While frame events are on, the control device becomes readable
+ * (select/poll) whenever the board finishes a frame. A read then
+ * returns the current done sequence numbers, one unsigned 32bit
+ * number per frame id, up to 256 of them. The board increments the
+ * number for a frame each time it finishes it. A read blocks until
+ * there is a frame event that this open of the control device has
+ * not read yet, or fails with EAGAIN if O_NONBLOCK is set. (Linux
+ * only.)
+ */
+# define UCRX_FRAME_EVENTS UCRX_(0,6)
+
+/*
+ * UCRX_SET_FIRMWARE_ID
+ * UCRX_GET_FIRMWARE_ID
+ * The driver keeps a firmware id string for each board, on behalf of
+ * the program that loads the firmware. The loader sets it after the
+ * firmware is running, and the driver clears it (to an empty string)
+ * whenever the board is reset or restarted. So a loader can tell that
+ * the firmware it wants is already running on the board. The driver
+ * does not interpret the string. The argument points to a
+ * ucrx_firmware_id_s, and the id must be nul terminated. (Linux
+ * only.)
+ */
+# define UCRX_FIRMWARE_ID_MAX 128
+struct ucrx_firmware_id_s {
+      char id[UCRX_FIRMWARE_ID_MAX];
+};
+# define UCRX_SET_FIRMWARE_ID UCRX_(0,7)
+# define UCRX_GET_FIRMWARE_ID UCRX_(0,8)
+
+/*
+ * UCRX_SET_PROM_IDENT
+ * UCRX_GET_PROM_IDENT
+ * The driver keeps the PROM ident text for each board, on behalf of
+ * the library that reads it from the PROM monitor. Reading it takes
+ * board resets, so the library reads it once and caches it here. The
+ * ident survives board resets and restarts, as the PROM does not
+ * change, but the driver clears it (to an empty string) when the
+ * board is removed with UCRX_REMOVE. The argument points to a
+ * ucrx_prom_ident_s, and the ident must be nul terminated. (Linux
+ * only.)
+ */
+# define UCRX_PROM_IDENT_MAX 1024
+struct ucrx_prom_ident_s {
+      char ident[UCRX_PROM_IDENT_MAX];
+};
+# define UCRX_SET_PROM_IDENT UCRX_(0,9)
+# define UCRX_GET_PROM_IDENT UCRX_(0,11)
 
 /*
  * The controls only exist in the Linux device driver. They allow the
@@ -216,10 +216,7 @@ int ejsex_remove(struct Instance*xsp)
 	/* Free all the frames that this board may have had. This can
 	   be done directly because we know that the ISE board is held
 	   reset and there is no need to synchronize tables. */
-      { unsigned idx;
-        for (idx = 0 ;  idx < 16 ;  idx += 1)
-	      ucr_free_frame(xsp, idx);
-      }
+      ucr_forget_board(xsp);
 
       return 0;
 }
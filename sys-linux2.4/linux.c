@@ -32,6 +32,16 @@ unsigned ucr_major = 114;
 
 int ise_limit_frame_pages = 0;
 
+/* Frames are made of chunks of PAGE_SIZE<<ise_frame_page_order
+   bytes where possible. The default of 0 makes PAGE_SIZE chunks,
+   which all firmware understands. */
+static int ise_frame_page_order = 0;
+
+/* Each board keeps up to this many PAGE_SIZE pages worth of freed
+   frame chunks, to be reused by later frames. The default of 0
+   disables the pool. */
+static int ise_frame_pool_pages = 0;
+
 /* If page addresses may be 64bits, then enable (allow) support for
    FRAME64 frames. */
 static int ise_allow_frame64 = sizeof(unsigned long) > 4;
@@ -39,6 +49,8 @@ static int ise_allow_frame64 = sizeof(unsigned long) > 4;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)
 module_param(ucr_major, int, S_IRUGO);
 module_param(ise_limit_frame_pages, int, S_IRUGO);
+module_param(ise_frame_page_order, int, S_IRUGO);
+module_param(ise_frame_pool_pages, int, S_IRUGO);
 module_param(debug_flag, int, S_IRUGO);
 
 # define MOD_INC_USE_COUNT try_module_get(THIS_MODULE)
@@ -51,6 +63,12 @@ MODULE_PARM_DESC(ucr_major,"Use this major number");
 MODULE_PARM(ise_limit_frame_pages,"i");
 MODULE_PARM_DESC(ise_limit_frame_pages,"Limit total frame pages");
 
+MODULE_PARM(ise_frame_page_order,"i");
+MODULE_PARM_DESC(ise_frame_page_order,"Allocate frames in chunks of this page order");
+
+MODULE_PARM(ise_frame_pool_pages,"i");
+MODULE_PARM_DESC(ise_frame_pool_pages,"Keep this many freed frame pages per board");
+
 MODULE_PARM(debug_flag,"i");
 MODULE_PARM_DESC(debug_flag,"Enable debug messages");
 
@@ -133,17 +151,204 @@ static __u64 frame_page_bus(struct Instance*xsp, unsigned frame_nr, unsigned pag
       return page_bus;
 }
 
+/*
+ * Frames 0-15 are mapped at id<<28, and the frames past that at
+ * UCR_FRAME64_MMAP(id). Get the frame id from the mmap offset of a
+ * vma, and the offset into the frame where the vma starts. The id
+ * may be out of range if the offset is bogus.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,4,0)
+static unsigned vma_frame_nr(struct vm_area_struct*vma, unsigned long*offset)
+{
+      __u64 vma_offset = (__u64)vma->vm_pgoff << PAGE_SHIFT;
+
+      if (vma_offset >= UCR_FRAME64_MMAP(16)) {
+	    if (offset)
+		  *offset = vma_offset & ((1ULL << 36) - 1);
+	    return (vma_offset >> 36) + 15;
+      }
+
+      if (offset)
+	    *offset = vma_offset & 0x0fffffff;
+      return (vma_offset >> 28) & 0x0f;
+}
+#endif
+
+/*
+ * Mark (or unmark) the PAGE_SIZE pages of a frame chunk reserved to
+ * keep the pager away.
+ */
+static void reserve_frame_chunk(void*addr, unsigned long chunk, int flag)
+{
+      unsigned long off;
+
+      for (off = 0 ;  off < chunk ;  off += PAGE_SIZE) {
+	    char*virt = (char*)addr + off;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)
+	    if (flag)
+		  SetPageReserved(virt_to_page(virt));
+	    else
+		  ClearPageReserved(virt_to_page(virt));
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2,4,0)
+	    if (flag)
+		  mem_map_reserve(virt_to_page(virt));
+	    else
+		  mem_map_unreserve(virt_to_page(virt));
+#else
+	    if (flag)
+		  mem_map_reserve(MAP_NR(virt));
+	    else
+		  mem_map_unreserve(MAP_NR(virt));
+#endif
+      }
+}
+
+/*
+ * Freed frame chunks are kept in a per-board pool, up to
+ * ise_frame_pool_pages pages, so that making and freeing frames over
+ * and over does not allocate and release the DMA memory each
+ * time. Chunks in the pool stay reserved, and stay counted in
+ * ise_frame_pages_in_use.
+ */
+struct frame_pool_chunk {
+      struct frame_pool_chunk*next;
+      void*virt;
+      dma_addr_t phys;
+      unsigned long size;
+};
+
+static void free_frame_chunk(struct Instance*xsp, void*virt,
+			     dma_addr_t phys, unsigned long chunk)
+{
+      reserve_frame_chunk(virt, chunk, 0);
+      dma_free_coherent(&xsp->pci->dev, chunk, virt, phys);
+
+      if (ise_frame_pages_in_use >= (chunk / PAGE_SIZE))
+	    ise_frame_pages_in_use -= chunk / PAGE_SIZE;
+      else
+	    ise_frame_pages_in_use = 0;
+}
+
+/*
+ * Take a chunk of the given size from the pool. If the frame table
+ * only holds 32bit addresses, then the chunk must be in 32bit
+ * memory. The chunk is cleared, so that it shows nothing of the
+ * frame that last used it.
+ */
+static void* frame_pool_get(struct Instance*xsp, unsigned long chunk,
+			    int use_frame64, dma_addr_t*phys)
+{
+      struct frame_pool_chunk**cur;
+
+      for (cur = &xsp->frame_pool ;  *cur ;  cur = &(*cur)->next) {
+	    struct frame_pool_chunk*tmp = *cur;
+	    void*virt;
+
+	    if (tmp->size != chunk)
+		  continue;
+	    if (!use_frame64 && (((__u64)tmp->phys + chunk - 1) >> 32) != 0)
+		  continue;
+
+	    *cur = tmp->next;
+	    virt = tmp->virt;
+	    *phys = tmp->phys;
+	    kfree(tmp);
+
+	    xsp->frame_pool_pages -= chunk / PAGE_SIZE;
+	    xsp->frame_pool_hits += 1;
+	    memset(virt, 0, chunk);
+	    return virt;
+      }
+
+      xsp->frame_pool_misses += 1;
+      return 0;
+}
+
+/*
+ * Put a chunk that is no longer used by a frame into the pool, or
+ * release it if the pool is full.
+ */
+static void frame_pool_put(struct Instance*xsp, void*virt,
+			   dma_addr_t phys, unsigned long chunk)
+{
+      struct frame_pool_chunk*tmp;
+
+      if (xsp->frame_pool_pages + chunk/PAGE_SIZE > ise_frame_pool_pages) {
+	    free_frame_chunk(xsp, virt, phys, chunk);
+	    return;
+      }
+
+      tmp = kmalloc(sizeof (struct frame_pool_chunk), GFP_KERNEL);
+      if (tmp == 0) {
+	    free_frame_chunk(xsp, virt, phys, chunk);
+	    return;
+      }
+
+      tmp->virt = virt;
+      tmp->phys = phys;
+      tmp->size = chunk;
+      tmp->next = xsp->frame_pool;
+      xsp->frame_pool = tmp;
+
+      xsp->frame_pool_pages += chunk / PAGE_SIZE;
+      if (xsp->frame_pool_pages > xsp->frame_pool_high)
+	    xsp->frame_pool_high = xsp->frame_pool_pages;
+}
+
+/*
+ * Release all the chunks in the pool of the board.
+ */
+static void frame_pool_drain(struct Instance*xsp)
+{
+      while (xsp->frame_pool) {
+	    struct frame_pool_chunk*tmp = xsp->frame_pool;
+	    xsp->frame_pool = tmp->next;
+	    free_frame_chunk(xsp, tmp->virt, tmp->phys, tmp->size);
+	    kfree(tmp);
+      }
+
+      xsp->frame_pool_pages = 0;
+}
+
+/*
+ * Allocate a fresh frame chunk. If the table pointer is configured to
+ * support 64bit addresses, then we can allocate in 64bit address
+ * space. If not, then restrict to 32bit address space. Do not try
+ * hard to find large chunks, as smaller chunks will do.
+ */
+static void* alloc_frame_chunk(struct Instance*xsp, unsigned long chunk,
+			       unsigned order, int use_frame64,
+			       dma_addr_t*phys)
+{
+      if (use_frame64)
+	    return dma_alloc_coherent(&xsp->pci->dev, chunk, phys,
+				      order? GFP_KERNEL|__GFP_NOWARN
+				      : GFP_KERNEL);
+      else
+	    return dma_alloc_coherent(&xsp->pci->dev, chunk, phys,
+				      order? GFP_KERNEL|GFP_DMA32|__GFP_NOWARN
+				      : GFP_KERNEL|GFP_DMA32);
+}
+
 /*
  * The ucr_make_frame and ucr_free_frame functions perform the work of
  * allocating/releasing the frames. They check that the parameters are
- * reasonable, and do the allocation/release of memory. Allocate
- * PAGE_SIZE chunks because these are convenient for the mmap function.
+ * reasonable, and do the allocation/release of memory.
+ *
+ * A frame is made of physically contiguous chunks of PAGE_SIZE<<order
+ * bytes, and the chunk size is the page_size of the frame table.
+ * Larger chunks make the frame table smaller, and let xxfault map a
+ * whole chunk at a time. If a frame cannot be made of chunks of the
+ * requested order, make_frame_order fails and the caller tries again
+ * with smaller chunks.
  */
 
-int ucr_make_frame(struct Instance*xsp, unsigned id, unsigned long size)
+static long make_frame_order(struct Instance*xsp, unsigned id,
+			     unsigned long size, unsigned order)
 {
       unsigned idx;
-      unsigned npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+      unsigned long chunk = PAGE_SIZE << order;
+      unsigned npages = (size + chunk - 1) / chunk;
 
 	/* Allocate the page pointer block, and the pages
 	   themselves. If there is a problem, jump to error exit
@@ -172,12 +377,12 @@ int ucr_make_frame(struct Instance*xsp, unsigned id, unsigned long size)
       }
 
       xsp->frame_virt[id] = vmalloc(npages * sizeof(void*));
-      size = npages * PAGE_SIZE;
+      size = npages * chunk;
 
       xsp->frame[id]->magic = use_frame64? FRAME_TABLE_MAGIC64 : FRAME_TABLE_MAGIC;
       xsp->frame[id]->self  = tab_phys;
-      xsp->frame[id]->page_size  = PAGE_SIZE;
-      xsp->frame[id]->page_count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+      xsp->frame[id]->page_size  = chunk;
+      xsp->frame[id]->page_count = npages;
 
       if (xsp->frame[id]->magic == FRAME_TABLE_MAGIC64) {
 	    for (idx = 0 ;  idx < xsp->frame[id]->page_count ;  idx += 1) {
@@ -194,46 +399,56 @@ int ucr_make_frame(struct Instance*xsp, unsigned id, unsigned long size)
       for (idx = 0 ;  idx < xsp->frame[id]->page_count ;  idx += 1) {
 
 	    void*addr;
-
-	    if (ise_frame_pages_in_use >= ise_limit_frame_pages) {
-		  printk(KERN_INFO "ise%u: Frame failed "
-			 "due to configured page limit (of %d pages).\n",
-			 xsp->number, ise_limit_frame_pages);
-		  goto no_mem;
+	    dma_addr_t phys;
+
+	      /* Chunks from the pool are already reserved and
+		 counted, so can be used as is. */
+	    addr = frame_pool_get(xsp, chunk, use_frame64, &phys);
+
+	    if (addr == 0) {
+		    /* Memory held by the pool counts against the
+		       limit, so give it back before failing. */
+		  if (ise_frame_pages_in_use + (1 << order) > ise_limit_frame_pages)
+			frame_pool_drain(xsp);
+
+		  if (ise_frame_pages_in_use + (1 << order) > ise_limit_frame_pages) {
+			printk(KERN_INFO "ise%u: Frame failed "
+			       "due to configured page limit (of %d pages).\n",
+			       xsp->number, ise_limit_frame_pages);
+			goto no_mem;
+		  }
+
+		    /* Allocate an actual frame chunk. */
+		  addr = alloc_frame_chunk(xsp, chunk, order, use_frame64, &phys);
+
+		    /* The pool may hold chunks of other sizes that
+		       are in the way, so give them back and try
+		       once more before failing. */
+		  if (addr == 0 && xsp->frame_pool) {
+			frame_pool_drain(xsp);
+			addr = alloc_frame_chunk(xsp, chunk, order,
+						 use_frame64, &phys);
+		  }
+		  if (addr == 0)
+			goto no_mem;
+
+		  ise_frame_pages_in_use += 1 << order;
+
+		    /* Mark the pages reserved to keep the pager
+		       away. */
+		  reserve_frame_chunk(addr, chunk, 1);
 	    }
 
-	      /* Allocate an actual frame page. If the table pointer
-		 is configured to support 64bit addresses, then we can
-		 allocate in 64bit address space. If not, then
-		 restrict to 32bit address space. */
-	    if (xsp->frame[id]->magic == FRAME_TABLE_MAGIC64) {
-		  dma_addr_t phys;
-		  __u64 addr_bus;
-		  addr = dma_alloc_coherent(&xsp->pci->dev, PAGE_SIZE, &phys, GFP_KERNEL);
-		  addr_bus = phys;
+	      /* Save the bus address in the frame information. */
+	    if (use_frame64) {
+		  __u64 addr_bus = phys;
 		  xsp->frame[id]->page[idx*2+0] = addr_bus & 0xffffffff;
 		  xsp->frame[id]->page[idx*2+1] = (addr_bus>>32) & 0xffffffff;
 	    } else {
-		  dma_addr_t phys;
-		  addr = dma_alloc_coherent(&xsp->pci->dev, PAGE_SIZE, &phys, GFP_KERNEL|GFP_DMA32);
 		  xsp->frame[id]->page[idx] = phys;
-	    } 
-	    if (addr == 0)
-		  goto no_mem;
+	    }
 
 	    xsp->frame_virt[id][idx] = addr;
-	    ise_frame_pages_in_use += 1;
-
-	      /* Save the bus address in the frame information, and
-		 mark the page reserved to keep the pager away. */
-
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)
-	    SetPageReserved(virt_to_page(addr));
-#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2,4,0)
-	    mem_map_reserve(virt_to_page(addr));
-#else
-	    mem_map_reserve(MAP_NR(addr));
-#endif
       }
 
 
@@ -244,9 +459,13 @@ no_mem: { /* Gack! Not enough memory, clean up what I did get and
 	     return the correct error code. */
 	    unsigned jdx;
 
-	    printk("<1>ise%u: error: not enough memory for "
-		   "page %u of %u frame pages.\n", xsp->number, idx, npages);
+	    if (order == 0)
+		  printk("<1>ise%u: error: not enough memory for "
+			 "page %u of %u frame pages.\n", xsp->number, idx, npages);
 
+	      /* Free the chunks instead of pooling them. The caller
+		 tries again with smaller chunks, and chunks of this
+		 size in the pool would only be in the way. */
 	    for (jdx = 0 ;  jdx < xsp->frame[id]->page_count ;  jdx += 1) {
 		  void*virt;
 		  dma_addr_t phys = frame_page_bus(xsp, id, jdx);
@@ -255,17 +474,7 @@ no_mem: { /* Gack! Not enough memory, clean up what I did get and
 			continue;
 
 		  virt = xsp->frame_virt[id][jdx];
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)
-		  ClearPageReserved(virt_to_page(virt));
-#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2,4,0)
-		  mem_map_unreserve(virt_to_page(virt));
-#else
-		  mem_map_unreserve(MAP_NR(virt));
-#endif
-		  dma_free_coherent(&xsp->pci->dev, PAGE_SIZE, virt, phys);
-
-		  if (ise_frame_pages_in_use > 0)
-			ise_frame_pages_in_use -= 1;
+		  free_frame_chunk(xsp, virt, phys, chunk);
 	    }
 
 	    dma_free_coherent(&xsp->pci->dev, xsp->frame_tabsize[id], xsp->frame[id], xsp->frame[id]->self);
@@ -277,9 +486,40 @@ no_mem: { /* Gack! Not enough memory, clean up what I did get and
       }
 }
 
+long ucr_make_frame(struct Instance*xsp, unsigned id, unsigned long size)
+{
+      int order = ise_frame_page_order;
+      long rc;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,27)
+	/* Only xxfault knows how to map frame chunks. */
+      order = 0;
+#endif
+      if (order < 0)
+	    order = 0;
+
+	/* Do not use chunks much larger then the frame itself. */
+      while (order > 0 && (PAGE_SIZE << (order-1)) >= size)
+	    order -= 1;
+
+      for (;;) {
+	    rc = make_frame_order(xsp, id, size, order);
+	    if (rc >= 0 || order == 0)
+		  return rc;
+
+	    if (debug_flag & UCR_TRACE_FRAME)
+		  printk(DEVICE_NAME "%u: no frame chunks of order %d for "
+			 "frame %u, trying smaller chunks.\n",
+			 xsp->number, order, id);
+
+	    order -= 1;
+      }
+}
+
 int ucr_free_frame(struct Instance*xsp, unsigned id)
 {
       unsigned idx;
+      unsigned long chunk;
       dma_addr_t tab_phys;
 
       if (xsp->frame[id] == 0)
@@ -302,26 +542,21 @@ int ucr_free_frame(struct Instance*xsp, unsigned id)
 	    return 0;
       }
 
+      chunk = xsp->frame[id]->page_size;
       for (idx = 0 ;  idx < xsp->frame[id]->page_count ;  idx += 1) {
 	    dma_addr_t phys = frame_page_bus(xsp, id, idx);
 	    void* virt = xsp->frame_virt[id][idx];
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)
-	    ClearPageReserved(virt_to_page(virt));
-#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2,4,0)
-	    mem_map_unreserve(virt_to_page(virt));
-#else
-	    mem_map_unreserve(MAP_NR(virt));
-#endif
-	    dma_free_coherent(&xsp->pci->dev, PAGE_SIZE, virt, phys);
-
-	    if (ise_frame_pages_in_use > 0)
-		  ise_frame_pages_in_use -= 1;
+	    frame_pool_put(xsp, virt, phys, chunk);
       }
 
       tab_phys = xsp->frame[id]->self;
       dma_free_coherent(&xsp->pci->dev, xsp->frame_tabsize[id], xsp->frame[id], tab_phys);
+      vfree(xsp->frame_virt[id]);
       xsp->frame[id] = 0;
+      xsp->frame_virt[id] = 0;
       xsp->frame_tabsize[id] = 0;
+      xsp->frame_prefault[id] = 0;
+      xsp->frame_faults[id] = 0;
       return 0;
 }
 
@@ -341,9 +576,17 @@ static int xxopen(struct inode *inode, struct file *file)
       xsp = inst + minor;
 
       if (control_flag) {
-	    rc =  ucrx_open(xsp);
-	    if (rc != 0)
+	    file->private_data = kmalloc(sizeof (struct ControlData),
+					 GFP_KERNEL);
+	    if (file->private_data == 0)
+		  return -ENOMEM;
+
+	    rc =  ucrx_open(xsp, (struct ControlData*)file->private_data);
+	    if (rc != 0) {
+		  kfree(file->private_data);
+		  file->private_data = 0;
 		  return rc;
+	    }
 
       } else {
 
@@ -371,7 +614,9 @@ int xxrelease(struct inode *inode, struct file *file)
       struct ChannelData*xpd = (struct ChannelData*)file->private_data;
 
       if (control_flag) {
-	    ucrx_release(xsp);
+	    struct ControlData*cdp = (struct ControlData*)file->private_data;
+	    ucrx_release(xsp, cdp);
+	    kfree(cdp);
       } else {
 	    ucr_release(xsp, xpd);
 	    kfree(xpd);
@@ -390,7 +635,9 @@ static ssize_t xxread(struct file *file, char *bytes, size_t count, loff_t*off)
       struct ChannelData*xpd = (struct ChannelData*)file->private_data;
 
       if (control_flag)
-	    return -ENOSYS;
+	    return ucrx_read(xsp, (struct ControlData*)file->private_data,
+			     bytes, count,
+			     (file->f_flags&O_NONBLOCK)? 0 : 1);
 
       rc = ucr_read(xsp, xpd, bytes, count, 
 		    (file->f_flags&O_NONBLOCK)? 0 : 1);
@@ -413,13 +660,83 @@ static ssize_t xxwrite(struct file*file, const char*bytes,
       if (control_flag)
 	    return -ENOSYS;
 
-      rc = ucr_write(xsp, xpd, bytes, count);
+      rc = ucr_write(xsp, xpd, bytes, count,
+		     (file->f_flags&O_NONBLOCK)? 0 : 1);
       if (rc > 0)
 	    *off += rc;
 
       return rc;
 }
 
+/*
+ * Vectored writes (writev) hand all the segments to ucr_write in one
+ * pass through the driver, so that a batch of lines from the library
+ * goes into the write ring together and needs only one flush. The
+ * write stops at the first segment that is not completely written,
+ * which only happens if it is interrupted or non-blocking.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,19,0)
+static ssize_t xxwrite_iter(struct kiocb*iocb, struct iov_iter*from)
+{
+      struct file*file = iocb->ki_filp;
+      unsigned minor = MINOR(file_inode(file)->i_rdev) & 0x7f;
+      int control_flag = (MINOR(file_inode(file)->i_rdev) & 0x80) != 0;
+      struct Instance*xsp = inst + minor;
+      struct ChannelData*xpd = (struct ChannelData*)file->private_data;
+      int block_flag = (file->f_flags&O_NONBLOCK)? 0 : 1;
+      ssize_t total = 0;
+
+      if (control_flag)
+	    return -ENOSYS;
+
+      while (iov_iter_count(from) > 0) {
+	    struct iovec seg = iov_iter_iovec(from);
+	    long rc = ucr_write(xsp, xpd, seg.iov_base, seg.iov_len,
+				block_flag);
+	    if (rc < 0)
+		  return total? total : rc;
+
+	    iov_iter_advance(from, rc);
+	    total += rc;
+	    if (rc < seg.iov_len)
+		  break;
+      }
+
+      iocb->ki_pos += total;
+      return total;
+}
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,19)
+static ssize_t xxaio_write(struct kiocb*iocb, const struct iovec*iov,
+			   unsigned long nr_segs, loff_t pos)
+{
+      struct file*file = iocb->ki_filp;
+      unsigned minor = MINOR(file_inode(file)->i_rdev) & 0x7f;
+      int control_flag = (MINOR(file_inode(file)->i_rdev) & 0x80) != 0;
+      struct Instance*xsp = inst + minor;
+      struct ChannelData*xpd = (struct ChannelData*)file->private_data;
+      int block_flag = (file->f_flags&O_NONBLOCK)? 0 : 1;
+      ssize_t total = 0;
+      unsigned long idx;
+
+      if (control_flag)
+	    return -ENOSYS;
+
+      for (idx = 0 ;  idx < nr_segs ;  idx += 1) {
+	    long rc = ucr_write(xsp, xpd, iov[idx].iov_base,
+				iov[idx].iov_len, block_flag);
+	    if (rc < 0)
+		  return total? total : rc;
+
+	    total += rc;
+	    if (rc < iov[idx].iov_len)
+		  break;
+      }
+
+      iocb->ki_pos = pos + total;
+      return total;
+}
+#endif
+
 static long xxioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
       unsigned minor = MINOR(file_inode(file)->i_rdev) & 0x7f;
@@ -428,9 +745,11 @@ static long xxioctl(struct file *file, unsigned int cmd, unsigned long arg)
       struct ChannelData*xpd = (struct ChannelData*)file->private_data;
 
       if (control_flag)
-	    return ucrx_ioctl(xsp, cmd, arg);
+	    return ucrx_ioctl(xsp, (struct ControlData*)file->private_data,
+			      cmd, arg);
       else
-	    return ucr_ioctl(xsp, xpd, cmd, arg);
+	    return ucr_ioctl(xsp, xpd, cmd, arg,
+			     (file->f_flags&O_NONBLOCK)? 0 : 1);
 }
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,0)
@@ -464,14 +783,32 @@ static irqreturn_t xxirq(int irq, void *dev_id EXTRA_IRQ_ARGS)
 static unsigned int xxselect(struct file*file, poll_table*pt)
 {
       unsigned minor = MINOR(file_inode(file)->i_rdev) & 0x7f;
+      int control_flag = (MINOR(file_inode(file)->i_rdev) & 0x80) != 0;
       struct Instance*xsp = inst + minor;
       struct ChannelData*xpd = (struct ChannelData*)file->private_data;
+      unsigned int mask = 0;
 
-      poll_wait(file, &xsp->dispatch_sync, pt);
+	/* The control device is readable when there is a frame
+	   event that this open has not read. */
+      if (control_flag) {
+	    struct ControlData*cdp = (struct ControlData*)file->private_data;
+	    poll_wait(file, &xsp->frame_event_sync, pt);
+	    if (xsp->frame_events
+		&& cdp->frame_event_seen != xsp->frame_event_count)
+		  mask |= POLLIN | POLLRDNORM;
+	    return mask;
+      }
+
+	/* Each channel has its own wait queue, so a poll is only
+	   woken by changes to this channel. */
+      poll_wait(file, &xpd->sync, pt);
       if (! CHANNEL_IN_EMPTY(xpd))
-	    return POLLIN | POLLRDNORM;
+	    mask |= POLLIN | POLLRDNORM;
 
-      return 0;
+      if (! CHANNEL_OUT_FULL(xpd))
+	    mask |= POLLOUT | POLLWRNORM;
+
+      return mask;
 }
 
 
@@ -483,7 +820,7 @@ static void xxvmopen(struct vm_area_struct*vma)
 
 	/* A new reference was spontaneously created. Count it. */
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,4,0)
-      unsigned frame_nr = ((vma->vm_pgoff*PAGE_SIZE) >> 28) & 0x0f;
+      unsigned frame_nr = vma_frame_nr(vma, 0);
 #else
       unsigned frame_nr = (vma->vm_offset >> 28) & 0x0f;
 #endif
@@ -502,7 +839,7 @@ static void xxvmclose(struct vm_area_struct*vma)
 
 	/* A vma referencing the frame has disappeared. */
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,4,0)
-      unsigned frame_nr = ((vma->vm_pgoff*PAGE_SIZE) >> 28) & 0x0f;
+      unsigned frame_nr = vma_frame_nr(vma, 0);
 #else
       unsigned frame_nr = (vma->vm_offset >> 28) & 0x0f;
 #endif
@@ -515,6 +852,88 @@ static void xxvmclose(struct vm_area_struct*vma)
 
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,27)
+/*
+ * Frames made of chunks larger then PAGE_SIZE are mapped VM_PFNMAP,
+ * and the first touch of a chunk maps all the pages of the chunk
+ * that the vma covers. The pages of a chunk are not compound pages,
+ * so they cannot be returned one at a time in vmf->page.
+ */
+static int fault_frame_chunk(struct vm_area_struct*vma, struct Instance*xsp,
+			     unsigned frame_nr, unsigned long offset)
+{
+      unsigned long chunk = xsp->frame[frame_nr]->page_size;
+      unsigned long chunk_nr = offset / chunk;
+      char*virt = (char*)xsp->frame_virt[frame_nr][chunk_nr];
+
+	/* Frame offsets map to the vma starting here. */
+      unsigned long vma_offset, vma_base, addr, end;
+
+      vma_frame_nr(vma, &vma_offset);
+      vma_base = vma->vm_start - vma_offset;
+      addr = vma_base + chunk_nr*chunk;
+      end = addr + chunk;
+
+      if (addr < vma->vm_start) {
+	    virt += vma->vm_start - addr;
+	    addr = vma->vm_start;
+      }
+      if (end > vma->vm_end)
+	    end = vma->vm_end;
+
+      if (debug_flag&UCR_TRACE_FRAME)
+	    printk(DEVICE_NAME "%d: fault frame %u chunk %lu\n",
+		   xsp->number, frame_nr, chunk_nr);
+
+      for ( ;  addr < end ;  addr += PAGE_SIZE, virt += PAGE_SIZE) {
+	    int rc = vm_insert_pfn(vma, addr, virt_to_phys(virt) >> PAGE_SHIFT);
+	      /* Another thread may have faulted the same chunk. */
+	    if (rc < 0 && rc != -EBUSY)
+		  return rc == -ENOMEM? VM_FAULT_OOM : VM_FAULT_SIGBUS;
+      }
+
+      return VM_FAULT_NOPAGE;
+}
+
+/*
+ * Map the whole range of the vma when it is made, if the frame has
+ * the prefault flag set. Each chunk of the frame is physically
+ * contiguous, so it takes one remap_pfn_range per chunk, and no
+ * faults are taken later.
+ */
+static int prefault_frame(struct vm_area_struct*vma, struct Instance*xsp,
+			  unsigned frame_nr, unsigned long offset)
+{
+      unsigned long chunk = xsp->frame[frame_nr]->page_size;
+      unsigned long addr = vma->vm_start;
+      unsigned long size = vma->vm_end - vma->vm_start;
+
+      if (debug_flag&UCR_TRACE_FRAME)
+	    printk(DEVICE_NAME "%d: prefault frame %u, %lu bytes\n",
+		   xsp->number, frame_nr, size);
+
+      while (size > 0) {
+	    unsigned long coff = offset % chunk;
+	    unsigned long trans = chunk - coff;
+	    char*virt = (char*)xsp->frame_virt[frame_nr][offset / chunk];
+	    int rc;
+
+	    if (trans > size)
+		  trans = size;
+
+	    rc = remap_pfn_range(vma, addr,
+				 virt_to_phys(virt + coff) >> PAGE_SHIFT,
+				 trans, vma->vm_page_prot);
+	    if (rc < 0)
+		  return rc;
+
+	    addr += trans;
+	    offset += trans;
+	    size -= trans;
+      }
+
+      return 0;
+}
+
 /*
  * Starting around 2.6.27, the nopage function is replaced with the
  * fault function. The obvious difference is that it takes a vm_fault
@@ -529,22 +948,25 @@ static int xxfault(struct vm_area_struct *vma, struct vm_fault *vmf)
       unsigned minor = MINOR(inode->i_rdev);
       struct Instance*xsp = inst+minor;
 
-      unsigned long vma_offset = vma->vm_pgoff*PAGE_SIZE;
+      unsigned long vma_offset;
 
       __u64 page_bus = 0;
 
-      frame_nr = (vma_offset >> 28) & 0x0f;
+      frame_nr = vma_frame_nr(vma, &vma_offset);
       offset = (unsigned long)vmf->virtual_address;
       offset = offset - vma->vm_start + vma_offset;
-      offset &= 0x0fffffff;
       page_nr = offset / PAGE_SIZE;
 
       if (debug_flag&UCR_TRACE_FRAME)
 	    printk(DEVICE_NAME "%d: nopage address=%p, offset=%p\n",
 		   xsp->number, vmf->virtual_address, (void*)offset);
 
+      xsp->frame_faults[frame_nr] += 1;
       page_bus = frame_page_bus(xsp, frame_nr, page_nr);
 
+      if (xsp->frame[frame_nr]->page_size != PAGE_SIZE)
+	    return fault_frame_chunk(vma, xsp, frame_nr, offset);
+
       vmf->page = virt_to_page(xsp->frame_virt[frame_nr][page_nr]);
       get_page(vmf->page);
 
@@ -572,18 +994,19 @@ static struct page* xxvmnopage(struct vm_area_struct*vma,
       unsigned minor = MINOR(inode->i_rdev);
       struct Instance*xsp = inst+minor;
 
-      unsigned long vma_offset = vma->vm_pgoff*PAGE_SIZE;
+      unsigned long vma_offset;
 
       __u64 page_bus = 0;
 
-      frame_nr = (vma_offset >> 28) & 0x0f;
-      offset = (address - vma->vm_start + vma_offset) & 0x0fffffff;
+      frame_nr = vma_frame_nr(vma, &vma_offset);
+      offset = address - vma->vm_start + vma_offset;
       page_nr = offset / PAGE_SIZE;
 
       if (debug_flag&UCR_TRACE_FRAME)
 	    printk(DEVICE_NAME "%d: nopage address=%p, offset=%p\n",
 		   xsp->number, (void*)address, (void*)offset);
 
+      xsp->frame_faults[frame_nr] += 1;
       page_bus = frame_page_bus(xsp, frame_nr, page_nr);
 
       page_out = virt_to_page(bus_to_virt(page_bus));
@@ -616,6 +1039,7 @@ static unsigned long xxvmnopage(struct vm_area_struct*vma,
 	    printk(DEVICE_NAME "%d: nopage address=%p, offset=%p\n",
 		   xsp->number, address, offset);
 
+      xsp->frame_faults[frame_nr] += 1;
       return (unsigned long)bus_to_virt(xsp->frame[frame_nr]->page[page_nr]);
 }
 #endif
@@ -630,10 +1054,128 @@ static struct vm_operations_struct xxvm_ops = {
 #endif
 };
 
+/*
+ * Channel rings are mapped through the channel device at offsets
+ * above the frames. The pages are all mapped when the mmap is made,
+ * so these vm operations only count the mappings. The ring of a
+ * channel cannot be replaced while it is mapped.
+ */
+static void xxringvmopen(struct vm_area_struct*vma)
+{
+      struct ChannelData*xpd = (struct ChannelData*)vma->vm_private_data;
+
+      MOD_INC_USE_COUNT;
+      xpd->ring_maps += 1;
+
+      if (debug_flag&UCR_TRACE_CHAN)
+	    printk(DEVICE_NAME "%u.%u (d): ring vmopen\n",
+		   xpd->xsp->number, xpd->channel);
+}
+
+static void xxringvmclose(struct vm_area_struct*vma)
+{
+      struct ChannelData*xpd = (struct ChannelData*)vma->vm_private_data;
+
+      MOD_DEC_USE_COUNT;
+      xpd->ring_maps -= 1;
+
+      if (debug_flag&UCR_TRACE_CHAN)
+	    printk(DEVICE_NAME "%u.%u (d): ring vmclose\n",
+		   xpd->xsp->number, xpd->channel);
+}
+
+static struct vm_operations_struct xxringvm_ops = {
+      open:   xxringvmopen,
+      close:  xxringvmclose,
+};
+
+static int xxmmap_ring(struct file*file, struct vm_area_struct*vma)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,10)
+      struct ChannelData*xpd = (struct ChannelData*)file->private_data;
+      unsigned long size = vma->vm_end - vma->vm_start;
+      unsigned long addr = vma->vm_start;
+      int rc;
+
+      if (xpd == 0 || xpd->table2 == 0)
+	    return -EINVAL;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
+      vma->vm_flags |= VM_IO | VM_DONTEXPAND | VM_DONTDUMP;
+#else
+      vma->vm_flags |= VM_IO | VM_RESERVED;
+#endif
+
+      if (vma->vm_pgoff >= (UCR_RING_MMAP_DATA >> PAGE_SHIFT)) {
+	    unsigned long offset = (vma->vm_pgoff
+			   - (UCR_RING_MMAP_DATA >> PAGE_SHIFT)) << PAGE_SHIFT;
+	    unsigned long total = (xpd->nobufs + xpd->nibufs) * xpd->buf_size;
+
+	    if ((offset + size) > total) {
+		  printk("ucr mmap: ring size %lu too big for ring(%lu)\n",
+			 offset + size, total);
+		  return -EINVAL;
+	    }
+
+	      /* Each buffer is physically contiguous, but the
+		 buffers are not contiguous with each other, so map
+		 them one at a time. */
+	    while (size > 0) {
+		  unsigned idx = offset / xpd->buf_size;
+		  unsigned long boff = offset % xpd->buf_size;
+		  unsigned long trans = xpd->buf_size - boff;
+		  char*buf = idx < xpd->nobufs
+			? xpd->out[idx]
+			: xpd->in[idx - xpd->nobufs];
+
+		  if (trans > size)
+			trans = size;
+
+		  rc = remap_pfn_range(vma, addr,
+				       virt_to_phys(buf + boff) >> PAGE_SHIFT,
+				       trans, vma->vm_page_prot);
+		  if (rc < 0)
+			return rc;
+
+		  addr += trans;
+		  offset += trans;
+		  size -= trans;
+	    }
+
+      } else {
+	    if (vma->vm_pgoff != (UCR_RING_MMAP_TABLE >> PAGE_SHIFT)
+		|| size != PAGE_SIZE)
+		  return -EINVAL;
+
+	      /* The process may look at the ring indices, but only
+		 the driver changes them. */
+	    if (vma->vm_flags & VM_WRITE)
+		  return -EPERM;
+	    vma->vm_flags &= ~VM_MAYWRITE;
+
+	    rc = remap_pfn_range(vma, addr,
+				 virt_to_phys((void*)xpd->table2) >> PAGE_SHIFT,
+				 PAGE_SIZE, vma->vm_page_prot);
+	    if (rc < 0)
+		  return rc;
+      }
+
+      vma->vm_private_data = xpd;
+      vma->vm_ops = &xxringvm_ops;
+      xxringvmopen(vma);
+
+      return 0;
+#else
+      return -ENOSYS;
+#endif
+}
+
 /*
  * The mmap function places the 16 possible frames into a linear
  * address space with the high 4 bits used to select the frame. The
- * frame is created by the ioctl elsewhere.
+ * frame is created by the ioctl elsewhere. The channel rings are
+ * mapped above that address space, see xxmmap_ring, and the frames
+ * past 15 are above that at UCR_FRAME64_MMAP(id).
  *
  * xxmmap will return an error if:
  *   The segment spans frames
@@ -658,6 +1200,12 @@ static int xxmmap(struct file*file, struct vm_area_struct*vma)
 		   "vm_end=%08lx\n", xsp->number, vma_offset,
 		   vma->vm_start, vma->vm_end);
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,4,0)
+      if (vma->vm_pgoff >= (UCR_RING_MMAP_TABLE >> PAGE_SHIFT)
+	  && vma->vm_pgoff < (UCR_FRAME64_MMAP(16) >> PAGE_SHIFT))
+	    return xxmmap_ring(file, vma);
+#endif
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0)
       vma->vm_flags |= VM_IO | VM_LOCKED | VM_DONTEXPAND | VM_DONTDUMP;
 #elif LINUX_VERSION_CODE >= KERNEL_VERSION(2,4,0)
@@ -666,17 +1214,24 @@ static int xxmmap(struct file*file, struct vm_area_struct*vma)
       vma->vm_flags |= VM_LOCKED;
 #endif
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,4,0)
+      frame_nr = vma_frame_nr(vma, &offset);
+#else
       frame_nr = (vma_offset >> 28) & 0x0f;
       offset = vma_offset & 0x0fffffffU;
+#endif
       size = vma->vm_end - vma->vm_start;
 
-      if (frame_nr != (((vma_offset+size) >> 28) & 0x0f)) {
+      if (frame_nr >= FRAME_MAX || xsp->frame[frame_nr] == 0)
+	    return -EINVAL;
+
+      if (frame_nr < 16 && frame_nr != (((vma_offset+size) >> 28) & 0x0f)) {
 	    printk("ucr mmap: span frames %u and %lu.\n", frame_nr,
 		   ((vma_offset+size) >> 28) & 0x0f);
 	    return -EINVAL;
       }
 
-      frame_size = xsp->frame[frame_nr]->page_size
+      frame_size = (unsigned long)xsp->frame[frame_nr]->page_size
 	    * xsp->frame[frame_nr]->page_count;
 
       if ( (offset + size) > frame_size) {
@@ -685,6 +1240,24 @@ static int xxmmap(struct file*file, struct vm_area_struct*vma)
 	    return -EINVAL;
       }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,27)
+	/* Frames made of large chunks, and prefaulted frames, are
+	   mapped by pfn, and that does not work for private (copy on
+	   write) mappings. */
+      if (xsp->frame[frame_nr]->page_size != PAGE_SIZE
+	  || xsp->frame_prefault[frame_nr]) {
+	    if (!(vma->vm_flags & VM_SHARED) && (vma->vm_flags & VM_MAYWRITE))
+		  return -EINVAL;
+	    vma->vm_flags |= VM_PFNMAP;
+      }
+
+      if (xsp->frame_prefault[frame_nr]) {
+	    int rc = prefault_frame(vma, xsp, frame_nr, offset);
+	    if (rc < 0)
+		  return rc;
+      }
+#endif
+
       vma->vm_ops = &xxvm_ops;
       xsp->frame_ref[frame_nr] += 1;
 
@@ -696,6 +1269,11 @@ static int xxmmap(struct file*file, struct vm_area_struct*vma)
 static struct file_operations ise_ops = {
       read:  xxread,
       write: xxwrite,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,19,0)
+      write_iter: xxwrite_iter,
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,19)
+      aio_write: xxaio_write,
+#endif
       poll:  xxselect,
       unlocked_ioctl: xxioctl,
       mmap:  xxmmap,
@@ -850,6 +1428,13 @@ static void ise_remove(struct pci_dev*dev)
 
 	/*pci_disable_device(xsp->pci);*/
       ucr_clear_instance(xsp);
+      frame_pool_drain(xsp);
+
+      if (ise_frame_pool_pages > 0)
+	    printk(DEVICE_NAME "%u: frame pool hits=%lu misses=%lu "
+		   "high water=%lu pages\n", xsp->number,
+		   xsp->frame_pool_hits, xsp->frame_pool_misses,
+		   xsp->frame_pool_high);
 }
 
 static const struct pci_device_id ise_idtable [] = {
@@ -881,6 +1466,9 @@ static int __init init_ise_module(void)
 
       printk(DEVICE_NAME ": Limit frames to total of %d pages\n",
 	     ise_limit_frame_pages);
+      if (ise_frame_pool_pages > 0)
+	    printk(DEVICE_NAME ": Keep up to %d freed frame pages per board\n",
+		   ise_frame_pool_pages);
 
       if (debug_flag)
 	    printk(DEVICE_NAME ": Debug_flag set to %u\n", debug_flag);
@@ -57,6 +57,9 @@
 # include  <linux/slab.h>
 # include  <linux/types.h>
 # include  <linux/wait.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,21)
+# include  <linux/hrtimer.h>
+#endif
 # include  <asm/segment.h>
 # include  <asm/io.h>
 # include  <asm/pgtable.h>
@@ -85,6 +88,21 @@ static inline void free_real_page(struct Instance*xsp, void*ptr, dma_addr_t badd
       dma_free_coherent(&xsp->pci->dev, PAGE_SIZE, ptr, baddr);
 }
 
+/* These are like the above, but allocate a physically contiguous
+   buffer of size bytes, rounded up to whole pages. */
+static inline void* allocate_real_pages(struct Instance*xsp, size_t size,
+					dma_addr_t*baddr)
+{
+      return dma_alloc_coherent(&xsp->pci->dev, PAGE_ALIGN(size), baddr,
+				GFP_KERNEL|GFP_DMA32);
+}
+
+static inline void free_real_pages(struct Instance*xsp, size_t size,
+				   void*ptr, dma_addr_t baddr)
+{
+      dma_free_coherent(&xsp->pci->dev, PAGE_ALIGN(size), ptr, baddr);
+}
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,0,0)
 static inline struct inode*file_inode(struct file*filp)
 { return filp->f_dentry->d_inode; }
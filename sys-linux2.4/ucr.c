@@ -41,6 +41,7 @@
 # define ROOT_TABLE_BELLMASK 0x01
 # define STATUS_BELLMASK     0x02
 # define CHANGE_BELLMASK     0x04
+# define FRAME_BELLMASK      0x08
 
 
 unsigned debug_flag = 0;
@@ -55,11 +56,14 @@ void ucr_init_instance(struct Instance*xsp)
       unsigned idx;
       xsp->dev = 0;
       xsp->suspense = 0;
+      spin_lock_init(&xsp->chan_lock);
       xsp->channels = 0;
 
       xsp->root = (struct root_table*)allocate_real_page(xsp, &baddr);
+      xsp->root_pending = 0;
+      xsp->root_pending_cdp = 0;
+      xsp->root_pending_files = 0;
       init_waitqueue_head(&xsp->root_sync);
-      init_waitqueue_head(&xsp->dispatch_sync);
 
       xsp->root->magic = ROOT_TABLE_MAGIC;
       xsp->root->self  = baddr;
@@ -67,14 +71,32 @@ void ucr_init_instance(struct Instance*xsp)
       for (idx = 0 ;  idx < 16 ;  idx += 1) {
 	    xsp->root->frame_table[idx].ptr = 0;
 	    xsp->root->frame_table[idx].magic = 0;
+      }
+
+      for (idx = 0 ;  idx < FRAME_MAX ;  idx += 1) {
 	    xsp->frame[idx] = 0;
 	    xsp->frame_ref[idx] = 0;
 	    xsp->frame_virt[idx] = 0;
       }
+      xsp->frame_dir = 0;
+      xsp->frame_pool = 0;
+      xsp->frame_pool_pages = 0;
+      xsp->frame_pool_high = 0;
+      xsp->frame_pool_hits = 0;
+      xsp->frame_pool_misses = 0;
+      xsp->firmware_id[0] = 0;
+      xsp->prom_ident[0] = 0;
+      xsp->frame_events = 0;
+      xsp->frame_event_count = 0;
+      init_waitqueue_head(&xsp->frame_event_sync);
+      xsp->status_count = 0;
+      init_waitqueue_head(&xsp->status_sync);
+      xsp->heartbeat_seq = 0;
 
       for (idx = 0 ;  idx < ROOT_TABLE_CHANNELS ;  idx += 1) {
 	    xsp->root->chan[idx].ptr = 0;
 	    xsp->root->chan[idx].magic = 0;
+	    xsp->chan_map[idx] = 0;
       }
 
       xsp->channel_table_pool = (struct channel_table*)allocate_real_page(xsp, &baddr);
@@ -85,14 +107,59 @@ void ucr_init_instance(struct Instance*xsp)
       xsp->channel_table_phys = baddr;
 }
 
+static void release_frame_dir(struct Instance*xsp, struct frame_directory*dp);
+static void release_frame_events(struct Instance*xsp);
+
 void ucr_clear_instance(struct Instance*xsp)
+{
+      ucr_free_frames(xsp);
+      free_real_page(xsp, xsp->channel_table_pool, xsp->channel_table_phys);
+}
+
+/*
+ * Free all the frames of the board, and the frame directory, without
+ * telling the board. This is only for when the board is held reset
+ * or is going away, and so is not looking at the tables.
+ */
+void ucr_free_frames(struct Instance*xsp)
 {
       unsigned idx;
-      for (idx = 0 ;  idx < 16 ;  idx += 1)
+      int dir_in_use = 0;
+
+      for (idx = 0 ;  idx < FRAME_MAX ;  idx += 1)
 	    if (xsp->frame[idx])
 		  ucr_free_frame(xsp, idx);
 
-      free_real_page(xsp, xsp->channel_table_pool, xsp->channel_table_phys);
+	/* Frames that are still mapped are not freed, and stay in
+	   the tables. */
+      for (idx = 16 ;  idx < FRAME_MAX ;  idx += 1)
+	    if (xsp->frame[idx])
+		  dir_in_use = 1;
+
+      if (xsp->frame_dir && !dir_in_use) {
+	    release_frame_dir(xsp, xsp->frame_dir);
+	    xsp->frame_dir = 0;
+	    release_frame_events(xsp);
+      }
+
+      for (idx = 0 ;  idx < 16 ;  idx += 1) {
+	    if (xsp->frame[idx])
+		  continue;
+	    if (idx == FRAME_DIR_SLOT && xsp->frame_dir)
+		  continue;
+	    xsp->root->frame_table[idx].ptr = 0;
+	    xsp->root->frame_table[idx].magic = 0;
+      }
+}
+
+/*
+ * The board was reset, so forget everything about the program that
+ * was running on it.
+ */
+void ucr_forget_board(struct Instance*xsp)
+{
+      ucr_free_frames(xsp);
+      xsp->firmware_id[0] = 0;
 }
 
 static struct channel_table*allocate_channel_table(struct Instance*xsp)
@@ -131,6 +198,138 @@ static void free_channel_table(struct Instance*xsp, volatile struct channel_tabl
       table->reserved = 0;
 }
 
+/*
+ * Allocate the buffers for the rings of a channel. The caller has
+ * already set up the ring depths, the buffer size, and the out_tab
+ * and in_tab pointers into the channel table. This allocates the
+ * buffers themselves and fills in the table descriptors.
+ */
+static void free_channel_ring(struct Instance*xsp, struct ChannelData*xpd);
+
+static int allocate_channel_ring(struct Instance*xsp, struct ChannelData*xpd)
+{
+      unsigned idx;
+
+      xpd->out = kmalloc(xpd->nobufs * sizeof(void*), GFP_KERNEL);
+      xpd->in  = kmalloc(xpd->nibufs * sizeof(void*), GFP_KERNEL);
+      if (xpd->out == 0 || xpd->in == 0) {
+	    kfree(xpd->out);
+	    kfree(xpd->in);
+	    xpd->out = 0;
+	    xpd->in = 0;
+	    return -ENOMEM;
+      }
+
+      for (idx = 0 ;  idx < xpd->nobufs ;  idx += 1) {
+	    xpd->out[idx] = 0;
+	    xpd->out_tab[idx].ptr = 0;
+      }
+      for (idx = 0 ;  idx < xpd->nibufs ;  idx += 1) {
+	    xpd->in[idx] = 0;
+	    xpd->in_tab[idx].ptr = 0;
+      }
+
+      for (idx = 0 ;  idx < xpd->nibufs ;  idx += 1) {
+	    dma_addr_t phys;
+	    xpd->in[idx] = allocate_real_pages(xsp, xpd->buf_size, &phys);
+	    if (xpd->in[idx] == 0)
+		  goto no_mem;
+	    xpd->in_tab[idx].ptr = phys;
+	    xpd->in_tab[idx].count = xpd->buf_size;
+      }
+
+      for (idx = 0 ;  idx < xpd->nobufs ;  idx += 1) {
+	    dma_addr_t phys;
+	    xpd->out[idx] = allocate_real_pages(xsp, xpd->buf_size, &phys);
+	    if (xpd->out[idx] == 0)
+		  goto no_mem;
+	    xpd->out_tab[idx].ptr = phys;
+	    xpd->out_tab[idx].count = xpd->buf_size;
+      }
+
+      return 0;
+
+ no_mem:
+      free_channel_ring(xsp, xpd);
+      return -ENOMEM;
+}
+
+static void free_channel_ring(struct Instance*xsp, struct ChannelData*xpd)
+{
+      unsigned idx;
+
+      if (xpd->in) {
+	    for (idx = 0 ;  idx < xpd->nibufs ;  idx += 1) {
+		  if (xpd->in[idx] == 0)
+			continue;
+		  free_real_pages(xsp, xpd->buf_size, xpd->in[idx],
+				  xpd->in_tab[idx].ptr);
+	    }
+	    kfree(xpd->in);
+	    xpd->in = 0;
+      }
+
+      if (xpd->out) {
+	    for (idx = 0 ;  idx < xpd->nobufs ;  idx += 1) {
+		  if (xpd->out[idx] == 0)
+			continue;
+		  free_real_pages(xsp, xpd->buf_size, xpd->out[idx],
+				  xpd->out_tab[idx].ptr);
+	    }
+	    kfree(xpd->out);
+	    xpd->out = 0;
+      }
+}
+
+/*
+ * Release the channel table that the channel is using, whether it is
+ * a fixed table from the pool or a ring table.
+ */
+static void release_channel_table(struct Instance*xsp, struct ChannelData*xpd)
+{
+      if (xpd->table2) {
+	    xpd->table2->magic = 0;
+	    xpd->table2->self = 0;
+	    free_real_page(xsp, (void*)xpd->table2, xpd->table2_phys);
+	    xpd->table2 = 0;
+      } else {
+	    free_channel_table(xsp, xpd->table);
+      }
+      xpd->table = 0;
+}
+
+/*
+ * Set up the ChannelData to use a fixed channel table from the
+ * pool. This is the table that every channel starts with when it is
+ * opened.
+ */
+static int attach_fixed_table(struct Instance*xsp, struct ChannelData*xpd)
+{
+      int rc;
+
+      xpd->table = allocate_channel_table(xsp);
+      if (xpd->table == 0)
+	    return -ENOMEM;
+
+      xpd->table2 = 0;
+      xpd->table->first_out_idx = 0;
+      xpd->table->next_out_idx  = 0;
+      xpd->table->first_in_idx  = 0;
+      xpd->table->next_in_idx   = 0;
+
+      xpd->nobufs = CHANNEL_OBUFS;
+      xpd->nibufs = CHANNEL_IBUFS;
+      xpd->buf_size = PAGE_SIZE;
+      xpd->out_tab = xpd->table->out;
+      xpd->in_tab  = xpd->table->in;
+
+      rc = allocate_channel_ring(xsp, xpd);
+      if (rc < 0)
+	    release_channel_table(xsp, xpd);
+
+      return rc;
+}
+
 /*
  * This function finds the ChannelData structure that has the
  * specified id. If no structures match, return 0. The result comes
@@ -138,17 +337,10 @@ static void free_channel_table(struct Instance*xsp, volatile struct channel_tabl
  */
 struct ChannelData* channel_by_id(struct Instance*xsp, unsigned short id)
 {
-      struct ChannelData*cp;
-
-      if (xsp->channels == 0) return 0;
-      cp = xsp->channels;
-
-      do {
-	    cp = cp->next;
-	    if (cp->channel == id) return cp;
-      } while (cp != xsp->channels);
+      if (id >= ROOT_TABLE_CHANNELS)
+	    return 0;
 
-      return 0;
+      return xsp->chan_map[id];
 }
 
 /*
@@ -215,6 +407,9 @@ static int root_to_board(struct Instance*xsp, __u32 root)
 
       cancel_time_delay(&root_timer);
 
+      if (dev_get_root_table_ack(xsp) != root)
+	    return -ETIMEDOUT;
+
       return 0;
 }
 
@@ -255,6 +450,98 @@ static int root_to_board_free(struct Instance*xsp, struct root_table*rp)
       return rc;
 }
 
+/*
+ * Channel opens and switches change the root table through these
+ * functions so that they can be batched. While a batch is open (see
+ * UCRX_ROOT_BATCH) root_edit returns the pending root table and
+ * root_commit leaves it pending, so that many channel changes are
+ * sent to the board with a single handshake. Without a batch, these
+ * are the usual duplicate_root and root_to_board_free. Only the
+ * process that began the batch adds to it. A change by any other
+ * process commits the batch first, so that its channels do not wait
+ * on someone else's commit.
+ */
+static int root_batch_commit(struct Instance*xsp);
+
+static struct root_table* root_edit(struct Instance*xsp)
+{
+      if (xsp->root_pending && xsp->root_pending_files == current->files)
+	    return xsp->root_pending;
+
+      root_batch_commit(xsp);
+      return duplicate_root(xsp);
+}
+
+static int root_commit(struct Instance*xsp, struct root_table*rp)
+{
+      if (rp == xsp->root_pending)
+	    return 0;
+
+      return root_to_board_free(xsp, rp);
+}
+
+/*
+ * Close any open batch by sending the pending root table to the
+ * board. Anything that needs the board to see a root table change
+ * right away (channel close, ring changes, frames) calls this first.
+ */
+static int root_batch_commit(struct Instance*xsp)
+{
+      struct root_table*rp = xsp->root_pending;
+
+      if (rp == 0)
+	    return 0;
+
+      xsp->root_pending = 0;
+      xsp->root_pending_cdp = 0;
+      xsp->root_pending_files = 0;
+
+      if (debug_flag & UCR_TRACE_PROTO)
+	    printk(DEVICE_NAME "%u: commit root table batch\n",
+		   xsp->number);
+
+	/* If no channels are open, the board is not connected and
+	   will get the root table when the next channel opens. */
+      if (xsp->channels == 0) {
+	    release_root(xsp, xsp->root);
+	    xsp->root = rp;
+	    return 0;
+      }
+
+      return root_to_board_free(xsp, rp);
+}
+
+/*
+ * Begin or commit a batch for the control device open cdp. A commit
+ * from an open that does not own the batch leaves it alone. A begin
+ * while another open owns a batch commits that batch first.
+ */
+int ucr_root_batch(struct Instance*xsp, struct ControlData*cdp, int flag)
+{
+      if (! flag) {
+	    if (xsp->root_pending_cdp != cdp)
+		  return 0;
+	    return root_batch_commit(xsp);
+      }
+
+      if (xsp->root_pending && xsp->root_pending_cdp == cdp)
+	    return 0;
+
+      root_batch_commit(xsp);
+
+      if (debug_flag & UCR_TRACE_PROTO)
+	    printk(DEVICE_NAME "%u: begin root table batch\n",
+		   xsp->number);
+
+      xsp->root_pending = duplicate_root(xsp);
+      if (xsp->root_pending == 0)
+	    return -ENOMEM;
+
+      xsp->root_pending_cdp = cdp;
+      xsp->root_pending_files = current->files;
+      return 0;
+}
+
 /*
  * this function is called to cause the channel to be switched to a
  * new id. This means moving the table to a new place in the root
@@ -264,7 +551,7 @@ static int switch_channel(struct Instance*xsp,
 			  struct ChannelData*xpd,
 			  unsigned newid)
 {
-      struct root_table*rt = duplicate_root(xsp);
+      struct root_table*rt = root_edit(xsp);
       if (rt == 0)
 	    return -ENOMEM;
 
@@ -274,9 +561,362 @@ static int switch_channel(struct Instance*xsp,
       rt->chan[xpd->channel].ptr = 0;
       rt->chan[xpd->channel].magic = 0;
 
+      xsp->chan_map[xpd->channel] = 0;
+      xsp->chan_map[newid] = xpd;
       xpd->channel = newid;
 
-      root_to_board_free(xsp, rt);
+      root_commit(xsp, rt);
+
+      return 0;
+}
+
+/*
+ * This function replaces the table of an idle channel with a ring
+ * table of the requested depth and buffer size. The new table is
+ * offered to the ISE board through a root table change, and the board
+ * accepts it by writing the magic number into the accept field before
+ * it acknowledges the root. If the board does not accept the table,
+ * or does not acknowledge the root in time, the previous table is put
+ * back and the channel is unchanged. The root table that puts it back
+ * is made before the offer, so that putting it back cannot fail for
+ * lack of memory. A handshake timeout is returned as -ETIMEDOUT.
+ */
+static int set_channel_ring(struct Instance*xsp, struct ChannelData*xpd,
+			    unsigned depth, unsigned buf_size)
+{
+      struct ChannelData ring, old;
+      struct root_table*newroot, *restore;
+      unsigned long flags;
+      int rc;
+
+      if (depth < 2 || depth > UCR_CHANNEL_RING_MAX_DEPTH)
+	    return -EINVAL;
+      if (buf_size == 0 || buf_size > UCR_CHANNEL_RING_MAX_BUF)
+	    return -EINVAL;
+
+      buf_size = PAGE_ALIGN(buf_size);
+
+      if (depth == xpd->nobufs && buf_size == xpd->buf_size)
+	    return 0;
+
+	/* The board must see the ring table right away, so this
+	   cannot be part of a batch. */
+      root_batch_commit(xsp);
+
+	/* The channel must be idle, or buffers would be lost. */
+      if (xpd->ring_maps != 0)
+	    return -EBUSY;
+      if (xpd->out_off != 0 || xpd->in_off != 0
+	  || xpd->table->first_out_idx != xpd->table->next_out_idx
+	  || ! CHANNEL_IN_EMPTY(xpd))
+	    return -EBUSY;
+
+      memset(&ring, 0, sizeof ring);
+      ring.table2 = allocate_real_page(xsp, &ring.table2_phys);
+      if (ring.table2 == 0)
+	    return -ENOMEM;
+
+      ring.table2->magic    = CHANNEL_TABLE_MAGIC2;
+      ring.table2->self     = ring.table2_phys;
+      ring.table2->frame    = ring.table2_phys;
+      ring.table2->reserved = CHANNEL_TABLE_MAGIC2;
+      ring.table2->first_out_idx = 0;
+      ring.table2->next_out_idx  = 0;
+      ring.table2->first_in_idx  = 0;
+      ring.table2->next_in_idx   = 0;
+      ring.table2->obufs    = depth;
+      ring.table2->ibufs    = depth;
+      ring.table2->buf_size = buf_size;
+      ring.table2->accept   = 0;
+
+      ring.table  = (volatile struct channel_table*)ring.table2;
+      ring.nobufs = depth;
+      ring.nibufs = depth;
+      ring.buf_size = buf_size;
+      ring.out_tab = ring.table2->buf;
+      ring.in_tab  = ring.table2->buf + depth;
+
+      rc = allocate_channel_ring(xsp, &ring);
+      if (rc < 0) {
+	    release_channel_table(xsp, &ring);
+	    return rc;
+      }
+
+	/* The restore root is a copy of the current root, which still
+	   has the old table of the channel. */
+      newroot = duplicate_root(xsp);
+      restore = duplicate_root(xsp);
+      if (newroot == 0 || restore == 0) {
+	    if (newroot)
+		  release_root(xsp, newroot);
+	    if (restore)
+		  release_root(xsp, restore);
+	    free_channel_ring(xsp, &ring);
+	    release_channel_table(xsp, &ring);
+	    return -ENOMEM;
+      }
+
+      newroot->chan[xpd->channel].ptr   = ring.table2->self;
+      newroot->chan[xpd->channel].magic = ring.table2->magic;
+      rc = root_to_board_free(xsp, newroot);
+
+      if (rc < 0 || ring.table2->accept != CHANNEL_TABLE_MAGIC2) {
+	    if (rc < 0)
+		  printk(DEVICE_NAME "%u.%u: no answer to ring table, "
+			 "keep %u buffers of %u bytes\n", xsp->number,
+			 xpd->channel, xpd->nobufs, xpd->buf_size);
+	    else if (debug_flag & UCR_TRACE_CHAN)
+		  printk(DEVICE_NAME "%u.%u (d): ring table refused, "
+			 "keep %u buffers of %u bytes\n", xsp->number,
+			 xpd->channel, xpd->nobufs, xpd->buf_size);
+
+	    if (root_to_board_free(xsp, restore) < 0) {
+		  printk(DEVICE_NAME "%u.%u: no answer restoring "
+			 "channel table.\n", xsp->number, xpd->channel);
+		  rc = -ETIMEDOUT;
+	    }
+
+	    free_channel_ring(xsp, &ring);
+	    release_channel_table(xsp, &ring);
+	    return rc < 0? rc : 0;
+      }
+
+      release_root(xsp, restore);
+
+	/* The board is now using the new table, so the old table and
+	   its buffers can be released. Swap the tables under the
+	   chan_lock so that ucr_irq (on any CPU) never looks at a
+	   table that is being freed. */
+      spin_lock_irqsave(&xsp->chan_lock, flags);
+      old.table  = xpd->table;
+      old.table2 = xpd->table2;
+      old.table2_phys = xpd->table2_phys;
+      old.nobufs = xpd->nobufs;
+      old.nibufs = xpd->nibufs;
+      old.buf_size = xpd->buf_size;
+      old.out_tab = xpd->out_tab;
+      old.in_tab  = xpd->in_tab;
+      old.out = xpd->out;
+      old.in  = xpd->in;
+
+      xpd->table  = ring.table;
+      xpd->table2 = ring.table2;
+      xpd->table2_phys = ring.table2_phys;
+      xpd->nobufs = ring.nobufs;
+      xpd->nibufs = ring.nibufs;
+      xpd->buf_size = ring.buf_size;
+      xpd->out_tab = ring.out_tab;
+      xpd->in_tab  = ring.in_tab;
+      xpd->out = ring.out;
+      xpd->in  = ring.in;
+      xpd->shadow_next_in = 0;
+      xpd->shadow_first_out = 0;
+      spin_unlock_irqrestore(&xsp->chan_lock, flags);
+
+      free_channel_ring(xsp, &old);
+      release_channel_table(xsp, &old);
+
+      if (debug_flag & UCR_TRACE_CHAN)
+	    printk(DEVICE_NAME "%u.%u (d): ring table of %u buffers "
+		   "of %u bytes\n", xsp->number, xpd->channel,
+		   xpd->nobufs, xpd->buf_size);
+
+      return 0;
+}
+
+/*
+ * Frames 16 and up are in the frame directory, which is in root slot
+ * FRAME_DIR_SLOT. The directory is changed by making a new copy and
+ * installing it with a new root table, the same as the root table
+ * itself. The copy is sent to the board by set_frame_dir, and a
+ * directory with no frames in it is taken out of the root table.
+ */
+static struct frame_directory* duplicate_frame_dir(struct Instance*xsp)
+{
+      dma_addr_t phys;
+      unsigned idx;
+      struct frame_directory*dp = allocate_real_page(xsp, &phys);
+      if (dp == 0) {
+	    printk(DEVICE_NAME "%u: ERROR ALLOCATING A FRAME DIRECTORY.\n",
+		   xsp->number);
+	    return 0;
+      }
+
+      if (xsp->frame_dir) {
+	    memcpy(dp, xsp->frame_dir, sizeof*dp);
+      } else {
+	    for (idx = 0 ;  idx < FRAME_DIR_FRAMES ;  idx += 1) {
+		  dp->frame_table[idx].ptr = 0;
+		  dp->frame_table[idx].magic = 0;
+	    }
+      }
+
+      dp->magic  = FRAME_DIR_MAGIC;
+      dp->self   = phys;
+      dp->count  = FRAME_DIR_FRAMES;
+      dp->accept = 0;
+      dp->events = xsp->frame_events? xsp->frame_events->self : 0;
+      dp->reserved[0] = 0;
+      dp->reserved[1] = 0;
+      dp->reserved[2] = 0;
+      return dp;
+}
+
+static void release_frame_dir(struct Instance*xsp, struct frame_directory*dp)
+{
+      dma_addr_t phys = dp->self;
+      dp->magic = 0x11111111;
+      dp->self = 0;
+      free_real_page(xsp, dp, phys);
+}
+
+static int set_frame_dir(struct Instance*xsp, struct frame_directory*dp)
+{
+      struct root_table*newroot;
+      unsigned idx, count = 0;
+
+      for (idx = 0 ;  idx < FRAME_DIR_FRAMES ;  idx += 1)
+	    if (dp->frame_table[idx].magic != 0)
+		  count += 1;
+
+	/* The directory also carries the frame events page, so
+	   install it if there is that even if there are no
+	   frames. */
+      if (dp->events != 0)
+	    count += 1;
+
+      newroot = duplicate_root(xsp);
+      if (newroot == 0)
+	    return -ENOMEM;
+
+      if (count > 0) {
+	    newroot->frame_table[FRAME_DIR_SLOT].ptr   = dp->self;
+	    newroot->frame_table[FRAME_DIR_SLOT].magic = FRAME_DIR_MAGIC;
+      } else {
+	    newroot->frame_table[FRAME_DIR_SLOT].ptr   = 0;
+	    newroot->frame_table[FRAME_DIR_SLOT].magic = 0;
+      }
+      root_to_board_free(xsp, newroot);
+
+	/* A board that does not know about directories does not
+	   accept it. Put the previous directory back. */
+      if (count > 0 && dp->accept != FRAME_DIR_MAGIC) {
+	    if (debug_flag & UCR_TRACE_FRAME)
+		  printk(DEVICE_NAME "%u: frame directory refused\n",
+			 xsp->number);
+
+	    newroot = duplicate_root(xsp);
+	    if (newroot == 0) {
+		  printk(DEVICE_NAME "%u: Unable to restore "
+			 "frame directory.\n", xsp->number);
+		  return -ENOMEM;
+	    }
+	    newroot->frame_table[FRAME_DIR_SLOT].ptr
+		  = xsp->frame_dir? xsp->frame_dir->self : 0;
+	    newroot->frame_table[FRAME_DIR_SLOT].magic
+		  = xsp->frame_dir? FRAME_DIR_MAGIC : 0;
+	    root_to_board_free(xsp, newroot);
+
+	    release_frame_dir(xsp, dp);
+	    return -EOPNOTSUPP;
+      }
+
+      if (xsp->frame_dir)
+	    release_frame_dir(xsp, xsp->frame_dir);
+
+      if (count > 0) {
+	    xsp->frame_dir = dp;
+      } else {
+	    release_frame_dir(xsp, dp);
+	    xsp->frame_dir = 0;
+      }
+
+      return 0;
+}
+
+static void release_frame_events(struct Instance*xsp)
+{
+      dma_addr_t phys;
+
+      if (xsp->frame_events == 0)
+	    return;
+
+      phys = xsp->frame_events->self;
+      xsp->frame_events->magic = 0x11111111;
+      xsp->frame_events->self = 0;
+      free_real_page(xsp, xsp->frame_events, phys);
+      xsp->frame_events = 0;
+
+	/* Wake any readers so that they notice that the events are
+	   gone. */
+      wake_up(&xsp->frame_event_sync);
+}
+
+/*
+ * Turn frame events on or off. The frame events page is carried by
+ * the frame directory, so this installs a new directory that points
+ * to the new page, or to no page.
+ */
+int ucr_frame_events(struct Instance*xsp, int flag)
+{
+      struct frame_directory*newdir;
+      struct frame_events*ev;
+      dma_addr_t phys;
+      unsigned idx;
+      int rc;
+
+      if ((xsp->frame_events != 0) == (flag != 0))
+	    return 0;
+
+	/* Frame 15 and the frame directory share a root slot. */
+      if (flag && xsp->frame[FRAME_DIR_SLOT])
+	    return -EBUSY;
+
+      root_batch_commit(xsp);
+
+      if (! flag) {
+	    ev = xsp->frame_events;
+	    xsp->frame_events = 0;
+	    newdir = duplicate_frame_dir(xsp);
+	    if (newdir)
+		  rc = set_frame_dir(xsp, newdir);
+	    else
+		  rc = -ENOMEM;
+
+	    xsp->frame_events = ev;
+	    if (rc < 0)
+		  return rc;
+
+	    release_frame_events(xsp);
+	    return 0;
+      }
+
+      ev = allocate_real_page(xsp, &phys);
+      if (ev == 0) {
+	    printk(DEVICE_NAME "%u: ERROR ALLOCATING FRAME EVENTS.\n",
+		   xsp->number);
+	    return -ENOMEM;
+      }
+
+      ev->magic = FRAME_EVENT_MAGIC;
+      ev->self  = phys;
+      for (idx = 0 ;  idx < FRAME_EVENT_FRAMES ;  idx += 1)
+	    ev->done_seq[idx] = 0;
+
+      xsp->frame_events = ev;
+      newdir = duplicate_frame_dir(xsp);
+      if (newdir)
+	    rc = set_frame_dir(xsp, newdir);
+      else
+	    rc = -ENOMEM;
+
+      if (rc < 0) {
+	    release_frame_events(xsp);
+	    return rc;
+      }
+
+      if (debug_flag & UCR_TRACE_FRAME)
+	    printk(DEVICE_NAME "%u: frame events on\n", xsp->number);
 
       return 0;
 }
@@ -287,8 +927,14 @@ static long make_and_set_frame(struct Instance*xsp, unsigned id,
       long asize;
       struct root_table*newroot;
 
+	/* Frame 15 and the frame directory share a root slot. */
+      if (id == FRAME_DIR_SLOT && xsp->frame_dir)
+	    return -EBUSY;
+      if (id >= 16 && xsp->frame[FRAME_DIR_SLOT])
+	    return -EBUSY;
+
       if (xsp->frame[id]) {
-	    asize = xsp->frame[id]->page_size * xsp->frame[id]->page_count;
+	    asize = (long)xsp->frame[id]->page_size * xsp->frame[id]->page_count;
 
 	    if (debug_flag & UCR_TRACE_FRAME)
 		  printk(DEVICE_NAME "%u: recycle frame %u "
@@ -302,6 +948,8 @@ static long make_and_set_frame(struct Instance*xsp, unsigned id,
 	    printk(DEVICE_NAME "%u: Make frame %u size=%lu bytes\n",
 		   xsp->number, id, size);
 
+      root_batch_commit(xsp);
+
       asize = ucr_make_frame(xsp, id, size);
       if (asize < 0) {
 	    if (debug_flag & UCR_TRACE_FRAME)
@@ -310,6 +958,30 @@ static long make_and_set_frame(struct Instance*xsp, unsigned id,
 	    return asize;
       }
 
+      if (id >= 16) {
+	    struct frame_directory*newdir = duplicate_frame_dir(xsp);
+	    int rc;
+
+	    if (newdir == 0) {
+		  ucr_free_frame(xsp, id);
+		  return -ENOMEM;
+	    }
+
+	    newdir->frame_table[id-16].ptr   = xsp->frame[id]->self;
+	    newdir->frame_table[id-16].magic = xsp->frame[id]->magic;
+	    rc = set_frame_dir(xsp, newdir);
+	    if (rc < 0) {
+		  ucr_free_frame(xsp, id);
+		  return rc;
+	    }
+
+	    if (debug_flag & UCR_TRACE_FRAME)
+		  printk(DEVICE_NAME "%u: frame %u final size=%lu bytes\n",
+			 xsp->number, id, asize);
+
+	    return asize;
+      }
+
       newroot = duplicate_root(xsp);
       if (newroot == 0) {
 	    if (debug_flag & UCR_TRACE_FRAME)
@@ -341,7 +1013,24 @@ static int free_and_set_frame(struct Instance*xsp, unsigned id)
 	    printk(DEVICE_NAME "%u: Free frame %u\n", xsp->number, id);
 
 	/* First tell the ISE board that the frame is gone. */
-      if (xsp->root) {
+      root_batch_commit(xsp);
+      if (id >= 16) {
+	    struct frame_directory*newdir;
+	    int rc;
+
+	    if (xsp->frame_ref[id] > 0)
+		  return -EBUSY;
+
+	    newdir = duplicate_frame_dir(xsp);
+	    if (newdir == 0)
+		  return -ENOMEM;
+	    newdir->frame_table[id-16].ptr = 0;
+	    newdir->frame_table[id-16].magic = 0;
+	    rc = set_frame_dir(xsp, newdir);
+	    if (rc < 0)
+		  return rc;
+
+      } else if (xsp->root) {
 	    newroot = duplicate_root(xsp);
 	    newroot->frame_table[id].ptr = 0;
 	    newroot->frame_table[id].magic = 0;
@@ -356,25 +1045,27 @@ static int wait_for_write_ring(struct Instance*xsp, struct ChannelData*xpd)
 {
       wait_queue_t wait_cell;
 
-      if (NEXT_OUT_IDX(xpd->table->next_out_idx) != xpd->table->first_out_idx)
+      if (! CHANNEL_OUT_FULL(xpd))
 	    return 0;
 
+	/* Mark the task as sleeping before testing the ring, so that
+	   a wake_up from the interrupt between the test and the
+	   schedule is not lost. */
       init_waitqueue_entry(&wait_cell, current);
-      add_wait_queue(&xsp->dispatch_sync, &wait_cell);
-      while ((NEXT_OUT_IDX(xpd->table->next_out_idx)
-		    == xpd->table->first_out_idx)
-	     && !signal_pending(current)) {
+      add_wait_queue(&xpd->sync, &wait_cell);
+      set_current_state(TASK_INTERRUPTIBLE);
+      while (CHANNEL_OUT_FULL(xpd) && !signal_pending(current)) {
 
-	    set_current_state(TASK_INTERRUPTIBLE);
 	    if (debug_flag & UCR_TRACE_CHAN)
 		  printk(DEVICE_NAME "%u.%u (d): wait for space"
 			 " in write ring.\n", xsp->number,
 			 xpd->channel);
 
 	    schedule();
+	    set_current_state(TASK_INTERRUPTIBLE);
       }
       set_current_state(TASK_RUNNING);
-      remove_wait_queue(&xsp->dispatch_sync, &wait_cell);
+      remove_wait_queue(&xpd->sync, &wait_cell);
 
       if (signal_pending(current)) {
 	    printk(DEVICE_NAME "%u.%u (d): Interrupted wait "
@@ -393,14 +1084,86 @@ static int wait_for_write_ring(struct Instance*xsp, struct ChannelData*xpd)
  * the operation is marked pending (and the read should abort).
  */
 
-static void read_timeout(unsigned long cd)
+static void read_timeout(struct ChannelData*xpd)
 {
-      struct ChannelData*xpd = (struct ChannelData*)cd;
-      struct Instance*xsp = xpd->xsp;
-
       xpd->read_timeout_flag = 1;
       xpd->read_timing = 0;
-      wake_up(&xsp->dispatch_sync);
+      wake_up(&xpd->sync);
+}
+
+/*
+ * The read timer is an hrtimer where the kernel has them, so that
+ * the read timeout is as precise as the microseconds it is given in,
+ * and a jiffies timer otherwise. The hrtimers of 2.6.16 to 2.6.20
+ * have no HRTIMER_MODE_REL and a different callback, so those kernels
+ * use the jiffies timer too.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,21)
+static enum hrtimer_restart read_timer_fun(struct hrtimer*tim)
+{
+      read_timeout(container_of(tim, struct ChannelData, read_timer));
+      return HRTIMER_NORESTART;
+}
+
+static void init_read_timer(struct ChannelData*xpd)
+{
+      hrtimer_init(&xpd->read_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+      xpd->read_timer.function = &read_timer_fun;
+}
+
+static void start_read_timer(struct ChannelData*xpd)
+{
+      long usec = xpd->read_timeout;
+      hrtimer_start(&xpd->read_timer,
+		    ktime_set(usec / 1000000, (usec % 1000000) * 1000),
+		    HRTIMER_MODE_REL);
+}
+
+static void stop_read_timer(struct ChannelData*xpd)
+{
+      hrtimer_cancel(&xpd->read_timer);
+}
+#else
+static void read_timer_fun(unsigned long cd)
+{
+      read_timeout((struct ChannelData*)cd);
+}
+
+static void init_read_timer(struct ChannelData*xpd)
+{
+      init_timer(&xpd->read_timer);
+}
+
+static void start_read_timer(struct ChannelData*xpd)
+{
+      long usec = xpd->read_timeout;
+      init_timer(&xpd->read_timer);
+      xpd->read_timer.data = (unsigned long)xpd;
+      xpd->read_timer.expires = jiffies + (usec / 1000000) * HZ
+	    + ((usec % 1000000) * HZ + 999999) / 1000000;
+      xpd->read_timer.function = &read_timer_fun;
+      add_timer(&xpd->read_timer);
+}
+
+static void stop_read_timer(struct ChannelData*xpd)
+{
+      del_timer(&xpd->read_timer);
+}
+#endif
+
+void ucr_set_read_timeout(struct ChannelData*xpd, long usec)
+{
+      xpd->read_timeout = usec;
+}
+
+void ucr_force_read_timeout(struct ChannelData*xpd)
+{
+      xpd->read_timeout_flag = 1;
+      if (xpd->read_timing) {
+	    stop_read_timer(xpd);
+	    xpd->read_timing = 0;
+      }
+      wake_up(&xpd->sync);
 }
 
 static int wait_for_read_data(struct Instance*xsp, struct ChannelData*xpd)
@@ -408,35 +1171,32 @@ static int wait_for_read_data(struct Instance*xsp, struct ChannelData*xpd)
       wait_queue_t wait_cell;
 
       init_waitqueue_entry(&wait_cell, current);
-      add_wait_queue(&xsp->dispatch_sync, &wait_cell);
+      add_wait_queue(&xpd->sync, &wait_cell);
 
       if (xpd->read_timeout > 0) {
 	    xpd->read_timing = 1;
-	    init_timer(&xpd->read_timer);
-	    xpd->read_timer.data = (unsigned long)xpd;
-	    xpd->read_timer.expires = jiffies + xpd->read_timeout;
-	    xpd->read_timer.function = &read_timeout;
-	    add_timer(&xpd->read_timer);
+	    start_read_timer(xpd);
       }
 
+      set_current_state(TASK_INTERRUPTIBLE);
       while (CHANNEL_IN_EMPTY(xpd)
 	     && ! signal_pending(current)
 	     && ! xpd->read_timeout_flag) {
 
-	    set_current_state(TASK_INTERRUPTIBLE);
 	    if (debug_flag & UCR_TRACE_CHAN)
 		  printk(DEVICE_NAME "%u.%u (d): wait for data"
 			 " in read ring\n",
 			 xsp->number, xpd->channel);
 
 	    schedule();
+	    set_current_state(TASK_INTERRUPTIBLE);
       }
 
       set_current_state(TASK_RUNNING);
-      remove_wait_queue(&xsp->dispatch_sync, &wait_cell);
+      remove_wait_queue(&xpd->sync, &wait_cell);
 
       if (xpd->read_timing) {
-	    del_timer(&xpd->read_timer);
+	    stop_read_timer(xpd);
 	    xpd->read_timing = 0;
       }
 
@@ -467,12 +1227,12 @@ static int flush_channel(struct Instance*xsp, struct ChannelData*xpd)
 	    return rc;
 
 	/* Set the count for the buffer that I am working on. */
-      xpd->table->out[xpd->table->next_out_idx].count = xpd->out_off;
+      xpd->out_tab[xpd->table->next_out_idx].count = xpd->out_off;
 
 	/* Initialize the count of the next buffer that I am going to
 	   be workin on shortly, and clear my offset pointer. */
-      rc = NEXT_OUT_IDX(xpd->table->next_out_idx);
-      xpd->table->out[rc].count = PAGE_SIZE;
+      rc = CHAN_NEXT_OUT_IDX(xpd, xpd->table->next_out_idx);
+      xpd->out_tab[rc].count = xpd->buf_size;
       xpd->out_off = 0;
 
 	/* Tell the target board that the next_out pointer has
@@ -498,9 +1258,9 @@ static int file_mark_channel(struct Instance*xsp, struct ChannelData*xpd)
 	/* This sends a file mark by writing a 0 count. The target
 	   understands that 0 count to be a file mark. */
 
-      xpd->table->out[xpd->table->next_out_idx].count = 0;
-      rc = NEXT_OUT_IDX(xpd->table->next_out_idx);
-      xpd->table->out[rc].count = PAGE_SIZE;
+      xpd->out_tab[xpd->table->next_out_idx].count = 0;
+      rc = CHAN_NEXT_OUT_IDX(xpd, xpd->table->next_out_idx);
+      xpd->out_tab[rc].count = xpd->buf_size;
       xpd->out_off = 0;
 
       xpd->table->next_out_idx = rc;
@@ -521,7 +1281,7 @@ static int sync_channel(struct Instance*xsp, struct ChannelData*xpd)
       wait_queue_t wait;
       init_waitqueue_entry(&wait, current);
 
-      add_wait_queue(&xsp->dispatch_sync, &wait);
+      add_wait_queue(&xpd->sync, &wait);
       while (1) {
 	    set_current_state(TASK_INTERRUPTIBLE);
 	    if (xpd->table->first_out_idx == xpd->table->next_out_idx)
@@ -538,7 +1298,7 @@ static int sync_channel(struct Instance*xsp, struct ChannelData*xpd)
 	    mask = dev_mask_irqs(xsp);
       }
       set_current_state(TASK_RUNNING);
-      remove_wait_queue(&xsp->dispatch_sync, &wait);
+      remove_wait_queue(&xpd->sync, &wait);
 
       dev_unmask_irqs(xsp, mask);
 
@@ -563,6 +1323,88 @@ static long do_sync(struct Instance*xsp, struct ChannelData*xpd)
       return 0;
 }
 
+/*
+ * These functions support processes that map the channel ring and
+ * fill or drain the buffers in place. ring_produce passes the out
+ * buffer at next_out_idx, which the process has already filled with
+ * count bytes, to the target board. ring_consume returns count in
+ * buffers to the target board. ring_wait waits for at least one in
+ * buffer, and returns the number of in buffers that are ready.
+ */
+static int ring_produce(struct Instance*xsp, struct ChannelData*xpd,
+			unsigned long count)
+{
+      int rc;
+
+      if (xpd->table2 == 0)
+	    return -EINVAL;
+      if (count == 0 || count > xpd->buf_size)
+	    return -EINVAL;
+      if (xpd->out_off != 0)
+	    return -EBUSY;
+
+	/* If the wait for ring space is interrupted, the buffer is
+	   not sent and the process must produce it again. */
+      xpd->out_off = count;
+      rc = flush_channel(xsp, xpd);
+      if (rc < 0)
+	    xpd->out_off = 0;
+
+      return rc;
+}
+
+static unsigned ring_in_ready(struct ChannelData*xpd)
+{
+      return (xpd->table->next_in_idx + xpd->nibufs
+	      - xpd->table->first_in_idx) % xpd->nibufs;
+}
+
+static int ring_consume(struct Instance*xsp, struct ChannelData*xpd,
+			unsigned long count)
+{
+      if (xpd->table2 == 0)
+	    return -EINVAL;
+      if (xpd->in_off != 0)
+	    return -EBUSY;
+      if (count > ring_in_ready(xpd))
+	    return -EINVAL;
+      if (count == 0)
+	    return 0;
+
+      while (count > 0) {
+	    xpd->in_tab[xpd->table->first_in_idx].count = xpd->buf_size;
+	    CHAN_INCR_IN_IDX(xpd, xpd->table->first_in_idx);
+	    count -= 1;
+      }
+
+      dev_set_bells(xsp, CHANGE_BELLMASK);
+      return 0;
+}
+
+static int ring_wait(struct Instance*xsp, struct ChannelData*xpd)
+{
+      int rc;
+
+      if (xpd->table2 == 0)
+	    return -EINVAL;
+
+      if (CHANNEL_IN_EMPTY(xpd)) {
+	    if (xpd->read_timeout == 0)
+		  return 0;
+
+	    rc = flush_channel(xsp, xpd);
+	    if (rc < 0)
+		  return rc;
+
+	    xpd->read_timeout_flag = 0;
+	    rc = wait_for_read_data(xsp, xpd);
+	    if (rc < 0)
+		  return rc;
+      }
+
+      return ring_in_ready(xpd);
+}
+
 /*
  * When a new file is opened, create a ChannelData structure to be
  * associated with that descriptor. The file by default gets channel
@@ -574,7 +1416,8 @@ static long do_sync(struct Instance*xsp, struct ChannelData*xpd)
  */
 int ucr_open(struct Instance*xsp, struct ChannelData*xpd)
 {
-      unsigned idx;
+      int rc;
+      unsigned long flags;
       struct root_table*newroot;
 
       if (xsp->suspense) {
@@ -599,33 +1442,31 @@ int ucr_open(struct Instance*xsp, struct ChannelData*xpd)
       xpd->out_off = 0;
       xpd->read_timeout = UCRX_TIMEOUT_OFF;
       xpd->read_timing = 0;
-      init_timer(&xpd->read_timer);
-
-      xpd->table = allocate_channel_table(xsp);
-      xpd->table->first_out_idx = 0;
-      xpd->table->next_out_idx  = 0;
-      xpd->table->first_in_idx  = 0;
-      xpd->table->next_in_idx   = 0;
-
-      for (idx = 0 ;  idx < CHANNEL_IBUFS ;  idx += 1) {
-	    dma_addr_t phys;
-	    xpd->in[idx] = allocate_real_page(xsp, &phys);
-	    xpd->table->in[idx].ptr = phys;
-	    xpd->table->in[idx].count = PAGE_SIZE;
-      }
-
-      for (idx = 0 ;  idx < CHANNEL_OBUFS ;  idx += 1) {
-	    dma_addr_t phys;
-	    xpd->out[idx] = allocate_real_page(xsp, &phys);
-	    xpd->table->out[idx].ptr = phys;
-	    xpd->table->out[idx].count = PAGE_SIZE;
+      init_read_timer(xpd);
+
+      xpd->out = 0;
+      xpd->in = 0;
+      xpd->ring_maps = 0;
+      init_waitqueue_head(&xpd->sync);
+
+	/* All channels start out with the fixed table. The
+	   UCR_CHANNEL_RING ioctl can later switch to a ring table. */
+      rc = attach_fixed_table(xsp, xpd);
+      if (rc < 0) {
+	    if (xsp->channels == 0)
+		  root_to_board(xsp, 0);
+	    return rc;
       }
 
+      xpd->shadow_next_in = 0;
+      xpd->shadow_first_out = 0;
 
 	/* Put the channel information into the channel list so that
 	   arriving packets can be properly dispatched to the
-	   process. */
+	   process. The interrupt handler walks this list, so change
+	   it only under the chan_lock. */
 
+      spin_lock_irqsave(&xsp->chan_lock, flags);
       if (xsp->channels == 0) {
 	    xsp->channels = xpd;
 	    xpd->next = xpd;
@@ -636,14 +1477,16 @@ int ucr_open(struct Instance*xsp, struct ChannelData*xpd)
 	    xpd->next->prev = xpd;
 	    xpd->prev->next = xpd;
       }
+      xsp->chan_map[0] = xpd;
+      spin_unlock_irqrestore(&xsp->chan_lock, flags);
 
 	/* Update the root table to contain the new channel. This
 	   involves some communication with the target board, so there
 	   is opportunity for blocking here. */
-      newroot = duplicate_root(xsp);
+      newroot = root_edit(xsp);
       newroot->chan[0].magic = xpd->table->magic;
       newroot->chan[0].ptr   = xpd->table->self;
-      root_to_board_free(xsp, newroot);
+      root_commit(xsp, newroot);
 
       return 0;
 }
@@ -655,14 +1498,17 @@ int ucr_open(struct Instance*xsp, struct ChannelData*xpd)
 
 void ucr_release(struct Instance*xsp, struct ChannelData*xpd)
 {
-      unsigned idx;
       struct root_table*newroot;
+      unsigned long flags;
 
 
 	/* Remove the channel from the root table that the ISE board
 	   is using. Do this early so that I am free to clean up the
-	   channel table afterwords. */
+	   channel table afterwords. The board may not yet have seen
+	   the channel if it was opened in a batch, so finish the
+	   batch first. */
 
+      root_batch_commit(xsp);
       newroot = duplicate_root(xsp);
       newroot->chan[xpd->channel].magic = 0;
       newroot->chan[xpd->channel].ptr = 0;
@@ -672,19 +1518,14 @@ void ucr_release(struct Instance*xsp, struct ChannelData*xpd)
 	    printk(DEVICE_NAME "%u.%u (d): releasing buffers\n",
 		   xsp->number, xpd->channel);
 
-      for (idx = 0 ;  idx < CHANNEL_IBUFS ;  idx += 1) {
-	    free_page((unsigned long)xpd->in[idx]);
-      }
-
-      for (idx = 0 ;  idx < CHANNEL_OBUFS ;  idx += 1) {
-	    free_page((unsigned long)xpd->out[idx]);
-      }
+      free_channel_ring(xsp, xpd);
 
 
 	/* No more communication with the target channel, so remove
 	   the ChannelData structure from the channel list, remove
 	   buffers, and release the xpd object. */
 
+      spin_lock_irqsave(&xsp->chan_lock, flags);
       if (xsp->channels == xpd)
 	    xsp->channels = xsp->channels->next;
       if (xsp->channels == xpd)
@@ -693,8 +1534,10 @@ void ucr_release(struct Instance*xsp, struct ChannelData*xpd)
 	    xpd->prev->next = xpd->next;
 	    xpd->next->prev = xpd->prev;
       }
+      xsp->chan_map[xpd->channel] = 0;
+      spin_unlock_irqrestore(&xsp->chan_lock, flags);
 
-      free_channel_table(xsp, xpd->table);
+      release_channel_table(xsp, xpd);
 
       if (debug_flag&UCR_TRACE_CHAN)
 	    printk(DEVICE_NAME "%u.%u (d): channel closed.\n",
@@ -763,7 +1606,7 @@ long ucr_read(struct Instance*xsp, struct ChannelData*xpd,
 	    }
 
 	    buf = xpd->in[xpd->table->first_in_idx];
-	    siz = xpd->table->in[xpd->table->first_in_idx].count;
+	    siz = xpd->in_tab[xpd->table->first_in_idx].count;
 
 	    trans = tcount;
 	    if ((trans + xpd->in_off) > siz)
@@ -787,8 +1630,8 @@ long ucr_read(struct Instance*xsp, struct ChannelData*xpd,
 		 changed. This may get me more read buffers. */
 	    if (xpd->in_off == siz) {
 		  xpd->in_off = 0;
-		  xpd->table->in[xpd->table->first_in_idx].count = PAGE_SIZE;
-		  INCR_IN_IDX(xpd->table->first_in_idx);
+		  xpd->in_tab[xpd->table->first_in_idx].count = xpd->buf_size;
+		  CHAN_INCR_IN_IDX(xpd, xpd->table->first_in_idx);
 		  dev_set_bells(xsp, CHANGE_BELLMASK);
 	    }
       }
@@ -824,10 +1667,15 @@ signalled:
  * proceed without me waiting around in the write, but I can't start a
  * new one until the DMA completes. For this to work, the mark bit 0
  * must start out as 1.
+ *
+ * If the block_flag is false, the write never waits for room in the
+ * ring. It writes what fits and returns the count, or -EAGAIN if
+ * nothing at all fits. A full buffer that cannot be sent yet is left
+ * pending, and sent by the next write or flush that finds room.
  */
 
 long ucr_write(struct Instance*xsp, struct ChannelData*xpd,
-	       const char*bytes, const unsigned long count)
+	       const char*bytes, const unsigned long count, int block_flag)
 {
       unsigned tcount = count;
 
@@ -843,8 +1691,18 @@ long ucr_write(struct Instance*xsp, struct ChannelData*xpd,
 	    idx = xpd->table->next_out_idx;
 	    buf = xpd->out[idx];
 
-	    if ((xpd->out_off + trans) > xpd->table->out[idx].count)
-		  trans = xpd->table->out[idx].count - xpd->out_off;
+	      /* A non-blocking write may have left a full buffer
+		 behind. Send it before writing more. */
+	    if (xpd->out_off == xpd->out_tab[idx].count) {
+		  if (!block_flag && CHANNEL_OUT_FULL(xpd))
+			break;
+		  if (flush_channel(xsp, xpd) < 0)
+			goto signalled;
+		  continue;
+	    }
+
+	    if ((xpd->out_off + trans) > xpd->out_tab[idx].count)
+		  trans = xpd->out_tab[idx].count - xpd->out_off;
 
 	    if (debug_flag & UCR_TRACE_CHAN)
 		  printk(DEVICE_NAME "%u.%u (d): write %u bytes to out_ptr=%u"
@@ -861,19 +1719,28 @@ long ucr_write(struct Instance*xsp, struct ChannelData*xpd,
 		 ISE board for reading. Block only if I am so far
 		 ahead that there is no place in the circular buffer
 		 for this message. */
-	    if (xpd->out_off == xpd->table->out[idx].count) {
+	    if (xpd->out_off == xpd->out_tab[idx].count) {
 
+		  if (!block_flag && CHANNEL_OUT_FULL(xpd))
+			continue;
 		  if (flush_channel(xsp, xpd) < 0)
 			goto signalled;
 	    }
       }
 
+      if (tcount == count && count > 0) {
+	    if (debug_flag & UCR_TRACE_CHAN)
+		  printk(DEVICE_NAME "%u.%u (d): ucr_write would block\n",
+			 xsp->number, xpd->channel);
+	    return -EAGAIN;
+      }
+
 
       if (debug_flag & UCR_TRACE_CHAN)
 	    printk(DEVICE_NAME "%u.%u (d): ucr_write complete %ld bytes\n",
-		   xsp->number, xpd->channel, count);
+		   xsp->number, xpd->channel, count - tcount);
 
-      return count;
+      return count - tcount;
 
 
 signalled:
@@ -897,7 +1764,7 @@ signalled:
 }
 
 int ucr_ioctl(struct Instance*xsp, struct ChannelData*xpd,
-	      unsigned int cmd, unsigned long arg)
+	      unsigned int cmd, unsigned long arg, int block_flag)
 {
 
       switch (cmd) {
@@ -907,6 +1774,9 @@ int ucr_ioctl(struct Instance*xsp, struct ChannelData*xpd,
 		  printk(DEVICE_NAME "%u.%u (d): Request flush.\n",
 			 xsp->number, xpd->channel);
 
+	    if (!block_flag && xpd->out_off && CHANNEL_OUT_FULL(xpd))
+		  return -EAGAIN;
+
 	    return flush_channel(xsp, xpd);
 
 	  case UCR_SYNC:
@@ -945,6 +1815,39 @@ int ucr_ioctl(struct Instance*xsp, struct ChannelData*xpd,
 
 	    return file_mark_channel(xsp, xpd);
 
+	  case UCR_CHANNEL_RING: {
+		struct ucr_channel_ring_s ring;
+		int rc;
+
+		if (copy_from_user(&ring, (void*)arg, sizeof ring) != 0)
+		      return -EFAULT;
+
+		if (debug_flag & UCR_TRACE_CHAN)
+		      printk(DEVICE_NAME "%u.%u (d): request ring of %u "
+			     "buffers of %u bytes\n", xsp->number,
+			     xpd->channel, ring.depth, ring.buf_size);
+
+		rc = set_channel_ring(xsp, xpd, ring.depth, ring.buf_size);
+		if (rc < 0)
+		      return rc;
+
+		ring.depth = xpd->nobufs;
+		ring.buf_size = xpd->buf_size;
+		if (copy_to_user((void*)arg, &ring, sizeof ring) != 0)
+		      return -EFAULT;
+
+		return 0;
+	  }
+
+	  case UCR_RING_PRODUCE:
+	    return ring_produce(xsp, xpd, arg);
+
+	  case UCR_RING_CONSUME:
+	    return ring_consume(xsp, xpd, arg);
+
+	  case UCR_RING_WAIT:
+	    return ring_wait(xsp, xpd);
+
 	  case UCR_MAKE_FRAME: {
 		unsigned id = 0xf & (arg >> 28);
 		return make_and_set_frame(xsp, id, arg&0x0fffffff);
@@ -955,6 +1858,52 @@ int ucr_ioctl(struct Instance*xsp, struct ChannelData*xpd,
 		return free_and_set_frame(xsp, id);
 	  }
 
+	  case UCR_MAKE_FRAME64: {
+		struct ucr_frame64_s frame;
+		long asize;
+
+		if (copy_from_user(&frame, (void*)arg, sizeof frame) != 0)
+		      return -EFAULT;
+
+		  /* Frames 0-15 are still mapped at id<<28, and the
+		     rest at UCR_FRAME64_MMAP, which leaves room for
+		     64Gig frames. */
+		if (frame.id >= FRAME_MAX || frame.size == 0)
+		      return -EINVAL;
+		if (frame.id < 16 && frame.size > 0x0fffffffULL)
+		      return -EINVAL;
+		if (frame.size > (1ULL << 36) || frame.size > LONG_MAX)
+		      return -EINVAL;
+
+		asize = make_and_set_frame(xsp, frame.id, frame.size);
+		if (asize < 0)
+		      return asize;
+
+		frame.size = asize;
+		if (copy_to_user((void*)arg, &frame, sizeof frame) != 0)
+		      return -EFAULT;
+
+		return 0;
+	  }
+
+	  case UCR_FREE_FRAME64:
+		if (arg >= FRAME_MAX)
+		      return -EINVAL;
+		return free_and_set_frame(xsp, arg);
+
+	  case UCR_FRAME_PREFAULT: {
+		unsigned long id = arg >> 8;
+		if (id >= FRAME_MAX || xsp->frame[id] == 0)
+		      return -EINVAL;
+		xsp->frame_prefault[id] = (arg & 1)? 1 : 0;
+		return 0;
+	  }
+
+	  case UCR_FRAME_FAULTS:
+		if (arg >= FRAME_MAX || xsp->frame[arg] == 0)
+		      return -EINVAL;
+		return xsp->frame_faults[arg] & 0x7fffffffUL;
+
       }
 
       return -ENOTTY;
@@ -970,15 +1919,44 @@ int ucr_irq(struct Instance*xsp)
       if (mask & ROOT_TABLE_BELLMASK)
 	    wake_up(&xsp->root_sync);
 
-	/* This bell happens when the target board responds to my
-	   sending a status signal. */
-      if (mask & STATUS_BELLMASK)
-	    ;
+	/* This bell happens when the target board changes its status
+	   register, i.e. when the bootprom has loaded the program. */
+      if (mask & STATUS_BELLMASK) {
+	    xsp->status_count += 1;
+	    wake_up(&xsp->status_sync);
+      }
+
+	/* This bell happens when the board has finished a frame. The
+	   frame events page says which. */
+      if (mask & FRAME_BELLMASK) {
+	    xsp->frame_event_count += 1;
+	    wake_up(&xsp->frame_event_sync);
+      }
 
 	/* This bell happens when it tells me that *it* has changed a
-	   channel table. */
-      if (mask & CHANGE_BELLMASK)
-	    wake_up(&xsp->dispatch_sync);
+	   channel table. The bell does not say which channel, so
+	   compare the indices that the board writes with the values
+	   seen at the last interrupt, and wake only the channels
+	   that changed. */
+      if (mask & CHANGE_BELLMASK) {
+	    struct ChannelData*xpd;
+	    spin_lock(&xsp->chan_lock);
+	    xpd = xsp->channels;
+	    if (xpd) do {
+		  __u32 next_in = xpd->table->next_in_idx;
+		  __u32 first_out = xpd->table->first_out_idx;
+
+		  if (next_in != xpd->shadow_next_in
+		      || first_out != xpd->shadow_first_out) {
+			xpd->shadow_next_in = next_in;
+			xpd->shadow_first_out = first_out;
+			wake_up(&xpd->sync);
+		  }
+
+		  xpd = xpd->next;
+	    } while (xpd != xsp->channels);
+	    spin_unlock(&xsp->chan_lock);
+      }
 
       return mask != 0;
 }
@@ -30,11 +30,22 @@
 
 # include  "ise_tables.h"
 
-# define CHANNEL_IN_EMPTY(x) ((x)->table->first_in_idx == (x)->table->next_in_idx)
-# define INCR_IN_IDX(x)  ((x) = ((x) + 1) % CHANNEL_IBUFS)
+/*
+ * The ring depth varies from channel to channel, so the driver
+ * indexes the rings with these in place of the fixed ring macros
+ * from ise_tables.h.
+ */
+# define CHAN_INCR_IN_IDX(xpd,x) ((x) = ((x) + 1) % (xpd)->nibufs)
+# define CHAN_NEXT_IN_IDX(xpd,x)  (((x) + 1) % (xpd)->nibufs)
+# define CHAN_NEXT_OUT_IDX(xpd,x) (((x) + 1) % (xpd)->nobufs)
+# define CHANNEL_OUT_FULL(xpd) \
+	(CHAN_NEXT_OUT_IDX(xpd, (xpd)->table->next_out_idx) == (xpd)->table->first_out_idx)
 
-# define NEXT_IN_IDX(x) (((x) + 1) % CHANNEL_IBUFS)
-# define NEXT_OUT_IDX(x) (((x) + 1) % CHANNEL_OBUFS)
+/*
+ * Frames 0-15 are in the root table, and the rest are in the frame
+ * directory. This is the same as UCR_FRAME_MAX.
+ */
+# define FRAME_MAX (16 + FRAME_DIR_FRAMES)
 
 /*
  * There are a few parameters that are local to an open file
@@ -48,25 +59,66 @@ struct ChannelData {
 
 	/* This is the address of the table for the channel, along
 	   with its physical address. This structure is used to
-	   communicate with the channel on the ISE board. */
+	   communicate with the channel on the ISE board. If the
+	   channel uses a ring table (CHANNEL_TABLE_MAGIC2) then this
+	   points to the common header of that table, and table2
+	   points to the whole thing. Otherwise table2 is 0. */
       volatile struct channel_table*table;
+      volatile struct channel_table2*table2;
+      dma_addr_t table2_phys;
+
+	/* These are the ring depths and the size of each buffer. The
+	   out_tab and in_tab point to the buffer descriptors in
+	   whichever table is in use. */
+      unsigned nobufs, nibufs;
+      unsigned buf_size;
+      volatile struct channel_buf*out_tab;
+      volatile struct channel_buf*in_tab;
 
 	/* The buffers referenced by the table are addressed (in
-	   kernel address space) by these pointers. */
-      void* in[CHANNEL_IBUFS];
-      void* out[CHANNEL_OBUFS];
+	   kernel address space) by these pointers. The arrays are
+	   allocated to match the ring depths. */
+      void**in;
+      void**out;
+
+	/* Number of process mappings of the ring. The ring cannot be
+	   changed while it is mapped. */
+      unsigned ring_maps;
 
       unsigned in_off;
       unsigned out_off;
 
-	/* This is the reat timeout to use. */
+	/* Processes that wait for this channel sleep here. The
+	   interrupt handler keeps the shadow copies of the indices
+	   that the board writes, so that it can tell which channels
+	   a CHANGE bell is for. */
+      wait_queue_head_t sync;
+      __u32 shadow_next_in;
+      __u32 shadow_first_out;
+
+	/* This is the read timeout to use, in microseconds, or
+	   UCRX_TIMEOUT_OFF. Kernels that have hrtimers time the read
+	   with one, so the timeout is not rounded to jiffies. */
       long read_timeout;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,21)
+      struct hrtimer read_timer;
+#else
       struct timer_list read_timer;
+#endif
       int read_timing, read_timeout_flag;
 
       struct ChannelData *next, *prev;
 };
 
+/*
+ * Each open of the control device has one of these. It holds the
+ * frame event count that the open last read, so that each reader
+ * sees every frame event once.
+ */
+struct ControlData {
+      unsigned long frame_event_seen;
+};
+
 /*
  * These are the parameters common to all the open files on the
  * target. This reflects the state of the target as a whole.
@@ -98,21 +150,80 @@ struct Instance {
       wait_queue_head_t root_sync;
       int root_timeout_flag;
 
-	/* Kernel and bus addresses of the frame tables. There can be
-	   up to 16 tables. frame_ref stores the number of mappings to
-	   the frame, and prevents the frame being removed if it is
-	   mapped. frame_order is the order used to allocate the
-	   frame via __get_free_pages. It is needed for release. */
-      struct frame_table*frame[16];
-      unsigned frame_ref[16];
-      size_t frame_tabsize[16];
-      void**frame_virt[16];
+	/* While a batch of root table changes is open, this is the
+	   root table that collects the changes. It is 0 otherwise.
+	   The batch belongs to the open of the control device that
+	   began it, and to the process (known by its file table) that
+	   did so. Only that open commits it when it is released, and
+	   a root table change by any other process commits the batch
+	   before it goes ahead on its own. */
+      struct root_table* root_pending;
+      struct ControlData*root_pending_cdp;
+      struct files_struct*root_pending_files;
 
-      wait_queue_head_t dispatch_sync;
+	/* Kernel and bus addresses of the frame tables. There can be
+	   up to FRAME_MAX tables. frame_ref stores the number of
+	   mappings to the frame, and prevents the frame being removed
+	   if it is mapped. frame_order is the order used to allocate
+	   the frame via __get_free_pages. It is needed for release. */
+      struct frame_table*frame[FRAME_MAX];
+      unsigned frame_ref[FRAME_MAX];
+      size_t frame_tabsize[FRAME_MAX];
+      void**frame_virt[FRAME_MAX];
+
+	/* frame_prefault is set by UCR_FRAME_PREFAULT to have mmap
+	   map the whole frame at once, and frame_faults counts the
+	   page faults taken on the frame. */
+      unsigned char frame_prefault[FRAME_MAX];
+      unsigned long frame_faults[FRAME_MAX];
+
+	/* The frame directory holds the frame tables of frames 16 and
+	   up. It is in root slot FRAME_DIR_SLOT while any of those
+	   frames exist, and is 0 otherwise. */
+      struct frame_directory*frame_dir;
+
+	/* The firmware id set by UCRX_SET_FIRMWARE_ID. This is
+	   cleared by ucr_forget_board when the board is reset. */
+      char firmware_id[UCRX_FIRMWARE_ID_MAX];
+
+	/* The PROM ident set by UCRX_SET_PROM_IDENT. Unlike the
+	   firmware id, this is kept when the board is reset, and is
+	   only cleared when the board is removed. */
+      char prom_ident[UCRX_PROM_IDENT_MAX];
+
+	/* While frame events are on, frame_events is the page where
+	   the board reports finished frames. frame_event_count counts
+	   the frame done bells, and frame_event_sync is woken by
+	   each. */
+      struct frame_events*frame_events;
+      unsigned long frame_event_count;
+      wait_queue_head_t frame_event_sync;
+
+	/* status_count counts the status bells from the board, and
+	   status_sync is woken by each. heartbeat_seq is the sequence
+	   number of the last UCRX_HEARTBEAT ping. */
+      unsigned long status_count;
+      wait_queue_head_t status_sync;
+      unsigned heartbeat_seq;
+
+	/* Freed frame chunks are kept here for reuse by later
+	   frames. The pool holds frame_pool_pages PAGE_SIZE pages,
+	   and the rest are statistics. */
+      struct frame_pool_chunk*frame_pool;
+      unsigned long frame_pool_pages;
+      unsigned long frame_pool_high;
+      unsigned long frame_pool_hits;
+      unsigned long frame_pool_misses;
 
 	/* Channels are a bit more complicated, and have a driver
-	   structure of their own. */
+	   structure of their own. The channels list links all the
+	   open channels, and chan_map indexes them by channel id.
+	   ucr_irq walks the list, so chan_lock (taken with the
+	   interrupts off) guards the links, and the channel tables
+	   that ucr_irq looks at. */
+      spinlock_t chan_lock;
       struct ChannelData *channels;
+      struct ChannelData *chan_map[ROOT_TABLE_CHANNELS];
 
       struct channel_table*channel_table_pool;
       __u32 channel_table_phys;
@@ -185,23 +296,40 @@ extern void ucr_release(struct Instance*xsp, struct ChannelData*xpd);
 extern long ucr_read(struct Instance*xsp, struct ChannelData*xpd,
 		     char *bytes, unsigned long count, int block_flag);
 extern long ucr_write(struct Instance*xsp, struct ChannelData*xpd,
-		      const char*bytes, const unsigned long count);
+		      const char*bytes, const unsigned long count,
+		      int block_flag);
 extern int  ucr_ioctl(struct Instance*xsp, struct ChannelData*xpd,
-		      unsigned cmd, unsigned long arg);
+		      unsigned cmd, unsigned long arg, int block_flag);
 extern int ucr_irq(struct Instance*xsp);
+extern int ucr_root_batch(struct Instance*xsp, struct ControlData*cdp,
+			  int flag);
 
-extern int  ucrx_open(struct Instance*xsp);
-extern void ucrx_release(struct Instance*xsp);
-extern int  ucrx_ioctl(struct Instance*xsp, unsigned cmd, unsigned long arg);
+extern int ucr_frame_events(struct Instance*xsp, int flag);
+
+extern int  ucrx_open(struct Instance*xsp, struct ControlData*cdp);
+extern void ucrx_release(struct Instance*xsp, struct ControlData*cdp);
+extern long ucrx_read(struct Instance*xsp, struct ControlData*cdp,
+		      char*bytes, unsigned long count, int block_flag);
+extern int  ucrx_ioctl(struct Instance*xsp, struct ControlData*cdp,
+			unsigned cmd, unsigned long arg);
 
 /*
  * The generic code needs to make frames occasionally, but the task
  * itself is operating system specific. These methods manage the
  * workings of frames.
  */
-extern int ucr_make_frame(struct Instance*xsp, unsigned id,
-			  unsigned long size);
+extern long ucr_make_frame(struct Instance*xsp, unsigned id,
+			   unsigned long size);
 extern int ucr_free_frame(struct Instance*xsp, unsigned id);
+extern void ucr_free_frames(struct Instance*xsp);
+extern void ucr_forget_board(struct Instance*xsp);
+
+/*
+ * Set the read timeout (in microseconds) of the channel, or force a
+ * timeout on the read that is waiting now.
+ */
+extern void ucr_set_read_timeout(struct ChannelData*xpd, long usec);
+extern void ucr_force_read_timeout(struct ChannelData*xpd);
 
 /*
  * These methods manage the /proc/drivers/isecons entry.
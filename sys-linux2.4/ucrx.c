@@ -59,10 +59,7 @@ static int ucrx_reset_board(struct Instance*xsp)
 	/* Free all the frames that this board may have had. This can
 	   be done directly because we know that the ISE board is held
 	   reset and there is no need to synchronize tables. */
-      { unsigned idx;
-        for (idx = 0 ;  idx < 16 ;  idx += 1)
-	      ucr_free_frame(xsp, idx);
-      }
+      ucr_forget_board(xsp);
 
 	/* Release the processor so it is free to execute the
 	   bootprom. This works my removing the reset state bit. */
@@ -102,10 +99,7 @@ static int ucrx_restart_board(struct Instance*xsp)
 	/* Free all the frames that this board may have had. This is
 	   safe to do because there are no longer any pointers to the
 	   table, and the processor has been rebooted. */
-      { unsigned idx;
-        for (idx = 0 ;  idx < 16 ;  idx += 1)
-	      ucr_free_frame(xsp, idx);
-      }
+      ucr_forget_board(xsp);
 
       return 0;
 }
@@ -165,6 +159,184 @@ static int ucrx_run_program(struct Instance*xsp)
       return 0;
 }
 
+/*
+ * A status_wait is a timeout for a wait on the status bell. The timer
+ * sets the flag and wakes the status_sync queue.
+ */
+struct status_wait {
+      struct Instance*xsp;
+      struct timer_list timer;
+      int timeout_flag;
+};
+
+static void status_wait_timeout(unsigned long cd)
+{
+      struct status_wait*sw = (struct status_wait*)cd;
+      sw->timeout_flag = 1;
+      wake_up(&sw->xsp->status_sync);
+}
+
+static void status_wait_start(struct Instance*xsp, struct status_wait*sw,
+			      unsigned long msec)
+{
+      sw->xsp = xsp;
+      sw->timeout_flag = 0;
+      init_timer(&sw->timer);
+      sw->timer.expires = jiffies + (msec*HZ + 999) / 1000;
+      sw->timer.data = (unsigned long)sw;
+      sw->timer.function = status_wait_timeout;
+      add_timer(&sw->timer);
+}
+
+static void status_wait_stop(struct status_wait*sw)
+{
+      del_timer(&sw->timer);
+}
+
+/*
+ * Run the program as soon as the board is ready for it, waiting up
+ * to arg milliseconds. The bootprom rings the status bell when it
+ * sets the Program Loaded bit, so the wait ends on that bell and not
+ * on a poll. Only the obsolete BIST method, which has no bell, is
+ * polled.
+ */
+static int ucrx_run_program_wait(struct Instance*xsp, unsigned long arg)
+{
+      wait_queue_t wait;
+      struct status_wait sw;
+      unsigned long seen;
+      int rc;
+
+      rc = ucrx_run_program(xsp);
+      if (rc != -EAGAIN || arg == 0)
+	    return rc;
+
+      if (debug_flag&UCR_TRACE_UCRX)
+	    printk("isex%u: wait up to %lu ms to run\n", xsp->number, arg);
+
+      status_wait_start(xsp, &sw, arg);
+
+      init_waitqueue_entry(&wait, current);
+      add_wait_queue(&xsp->status_sync, &wait);
+      for (;;) {
+	      /* Note the bell count before looking at the status, so
+		 that a bell after the look is not missed. */
+	    seen = xsp->status_count;
+	    rc = ucrx_run_program(xsp);
+	    if (rc != -EAGAIN)
+		  break;
+
+	    if (sw.timeout_flag) {
+		  rc = -ETIMEDOUT;
+		  break;
+	    }
+
+	    if (signal_pending(current)) {
+		  rc = -ERESTARTSYS;
+		  break;
+	    }
+
+	    set_current_state(TASK_INTERRUPTIBLE);
+	    if (xsp->status_count == seen && !sw.timeout_flag) {
+		  if (dev_get_status_resp(xsp) & 0x0001)
+			schedule();
+		  else
+			schedule_timeout(HZ/50 + 1);
+	    }
+	    set_current_state(TASK_RUNNING);
+      }
+      remove_wait_queue(&xsp->status_sync, &wait);
+      status_wait_stop(&sw);
+
+      if (debug_flag&UCR_TRACE_UCRX)
+	    printk("isex%u: run wait done, rc=%d\n", xsp->number, rc);
+
+      return rc;
+}
+
+/*
+ * Ping the firmware through the status registers, and wait for it to
+ * echo the ping. The sequence number goes in the high half of the
+ * status value, so the Start Program bit is never set, and it is only
+ * sent if the bootprom is not active. Only an echo of exactly this
+ * ping counts, or of the latest ping if another caller has sent one
+ * since, because the firmware then answers that one instead. An echo
+ * that is left over from an earlier ping does not count.
+ */
+static int ucrx_heartbeat(struct Instance*xsp, unsigned long arg)
+{
+      struct ucrx_heartbeat_s args;
+      wait_queue_t wait;
+      struct status_wait sw;
+      unsigned seq, echo;
+      __u32 status;
+      int rc = 0;
+
+      if (xsp->suspense)
+	    return -EBUSY;
+
+      if (copy_from_user(&args, (void*)arg, sizeof args) != 0)
+	    return -EFAULT;
+
+      args.flags = 0;
+      status = dev_get_status_resp(xsp);
+
+      if (status & 0x0001) {
+	    args.flags |= UCRX_HEARTBEAT_BOOTPROM;
+
+      } else {
+	    xsp->heartbeat_seq = (xsp->heartbeat_seq + 1) & 0x7fff;
+	    if (xsp->heartbeat_seq == 0)
+		  xsp->heartbeat_seq = 1;
+	    seq = xsp->heartbeat_seq;
+
+	    status_wait_start(xsp, &sw, args.timeout);
+	    init_waitqueue_entry(&wait, current);
+	    add_wait_queue(&xsp->status_sync, &wait);
+
+	    dev_set_status_value(xsp, 0x80000000 | (seq << 16));
+	    dev_set_bells(xsp, 0x0002);
+
+	    for (;;) {
+		  set_current_state(TASK_INTERRUPTIBLE);
+		  status = dev_get_status_resp(xsp);
+		  echo = (status >> 16) & 0x7fff;
+		  if (echo == seq || echo == xsp->heartbeat_seq) {
+			args.flags |= UCRX_HEARTBEAT_ANSWERED;
+			break;
+		  }
+		  if (sw.timeout_flag)
+			break;
+		  if (signal_pending(current)) {
+			rc = -ERESTARTSYS;
+			break;
+		  }
+		  schedule();
+	    }
+	    set_current_state(TASK_RUNNING);
+	    remove_wait_queue(&xsp->status_sync, &wait);
+	    status_wait_stop(&sw);
+      }
+
+      if (rc < 0)
+	    return rc;
+
+      args.status = status & 0xffff;
+      args.bells = xsp->status_count;
+
+      if (debug_flag&UCR_TRACE_UCRX)
+	    printk("isex%u: heartbeat status=%x flags=%x\n",
+		   xsp->number, args.status, args.flags);
+
+      if (copy_to_user((void*)arg, &args, sizeof args) != 0)
+	    return -EFAULT;
+
+      if (! (args.flags & (UCRX_HEARTBEAT_BOOTPROM|UCRX_HEARTBEAT_ANSWERED)))
+	    return -ETIMEDOUT;
+
+      return 0;
+}
+
 static int ucrx_diagnose(struct Instance*xsp, unsigned long arg)
 {
       unsigned magic, lineno, idx;
@@ -217,7 +389,23 @@ static int ucrx_diagnose(struct Instance*xsp, unsigned long arg)
 		   xsp->root->self, xsp->root->magic,
 		   xsp->root->self);
 
-	    for (idx = 0 ;  idx < 16 ;  idx += 1) {
+	    isecons_log(DEVICE_NAME "%u: FRAME POOL pages=%lu high=%lu "
+			"hits=%lu misses=%lu\n", xsp->number,
+			xsp->frame_pool_pages, xsp->frame_pool_high,
+			xsp->frame_pool_hits, xsp->frame_pool_misses);
+
+	    if (xsp->frame_dir)
+		  isecons_log(DEVICE_NAME "%u: FRAME DIRECTORY at %p(%x) "
+			      "accept=%x\n", xsp->number, xsp->frame_dir,
+			      xsp->frame_dir->self, xsp->frame_dir->accept);
+
+	    if (xsp->frame_events)
+		  isecons_log(DEVICE_NAME "%u: FRAME EVENTS at %p(%x) "
+			      "bells=%lu\n", xsp->number, xsp->frame_events,
+			      xsp->frame_events->self,
+			      xsp->frame_event_count);
+
+	    for (idx = 0 ;  idx < FRAME_MAX ;  idx += 1) {
 		  int use_page_count;
 		  int pidx;
 
@@ -230,6 +418,9 @@ static int ucrx_diagnose(struct Instance*xsp, unsigned long arg)
 			 xsp->frame[idx]->self,
 			 xsp->frame[idx]->page_size/1024,
 			 xsp->frame[idx]->page_count);
+		  isecons_log(DEVICE_NAME "%u:     prefault=%u faults=%lu\n",
+			      xsp->number, xsp->frame_prefault[idx],
+			      xsp->frame_faults[idx]);
 
 		  use_page_count = xsp->frame[idx]->page_count;
 		  if (use_page_count > 128) use_page_count = 128;
@@ -271,19 +462,24 @@ static int ucrx_diagnose(struct Instance*xsp, unsigned long arg)
 			       xpd->table->first_in_idx,
 			       xpd->table->next_in_idx);
 
-			for (idx = 0 ;  idx < CHANNEL_OBUFS ;  idx += 1)
+			isecons_log(DEVICE_NAME "%u.%u: RING "
+				    "obufs=%u, ibufs=%u, buf_size=%u\n",
+				    xsp->number, xpd->channel, xpd->nobufs,
+				    xpd->nibufs, xpd->buf_size);
+
+			for (idx = 0 ;  idx < xpd->nobufs ;  idx += 1)
 			      isecons_log(DEVICE_NAME "%u.%u: obuf %u: "
 				     "ptr=%x, count=%u\n",
 				     xsp->number, xpd->channel, idx,
-				     xpd->table->out[idx].ptr,
-				     xpd->table->out[idx].count);
+				     xpd->out_tab[idx].ptr,
+				     xpd->out_tab[idx].count);
 
-			for (idx = 0 ;  idx < CHANNEL_IBUFS ;  idx += 1)
+			for (idx = 0 ;  idx < xpd->nibufs ;  idx += 1)
 			      isecons_log(DEVICE_NAME "%u.%u: ibuf %u: "
 				     "ptr=%x, count=%u\n",
 				     xsp->number, xpd->channel, idx,
-				     xpd->table->in[idx].ptr,
-				     xpd->table->in[idx].count);
+				     xpd->in_tab[idx].ptr,
+				     xpd->in_tab[idx].count);
 
 
 			xpd = xpd->next;
@@ -315,6 +511,32 @@ static int ucrx_get_debug_flag(void)
       return (int)debug_flag;
 }
 
+/*
+ * Apply a read timeout, in microseconds, or one of the special
+ * UCRX_TIMEOUT_* values.
+ */
+static int set_read_timeout(struct ChannelData*xpd, long usec)
+{
+      if (usec >= 0) {
+	    ucr_set_read_timeout(xpd, usec);
+
+      } else switch (usec) {
+
+	  case UCRX_TIMEOUT_OFF:
+	    ucr_set_read_timeout(xpd, UCRX_TIMEOUT_OFF);
+	    break;
+
+	  case UCRX_TIMEOUT_FORCE:
+	    ucr_force_read_timeout(xpd);
+	    break;
+
+	  default:
+	    return -EINVAL;
+      }
+
+      return 0;
+}
+
 static int ucrx_timeout(struct Instance*xsp, unsigned long arg)
 {
       struct ChannelData*xpd;
@@ -327,42 +549,161 @@ static int ucrx_timeout(struct Instance*xsp, unsigned long arg)
       if (xpd == 0)
 	    return -EINVAL;
 
-      if (args.read_timeout >= 0) {
-	    xpd->read_timeout = (args.read_timeout * HZ + 999) / 1000;
+	/* The channel keeps its timeout in microseconds. */
+      if (args.read_timeout > LONG_MAX / 1000)
+	    args.read_timeout = LONG_MAX / 1000;
+      if (args.read_timeout > 0)
+	    args.read_timeout *= 1000;
 
-      } else switch (args.read_timeout) {
+      return set_read_timeout(xpd, args.read_timeout);
+}
 
-	  case UCRX_TIMEOUT_OFF:
-	    xpd->read_timeout = -1;
-	    break;
+static int ucrx_timeout_us(struct Instance*xsp, unsigned long arg)
+{
+      struct ChannelData*xpd;
+      struct ucrx_timeout_us_s args;
 
-	  case UCRX_TIMEOUT_FORCE:
-	    xpd->read_timeout_flag = 1;
-	    if (xpd->read_timing) {
-		  del_timer(&xpd->read_timer);
-		  xpd->read_timing = 0;
-	    }
-	    wake_up(&xsp->dispatch_sync);
-	    break;
+      if (copy_from_user(&args, (void*)arg, sizeof args) != 0)
+	    return -EFAULT;
 
-	  default:
+      xpd = channel_by_id(xsp, args.id);
+      if (xpd == 0)
+	    return -EINVAL;
+
+      return set_read_timeout(xpd, args.read_timeout_us);
+}
+
+
+static int ucrx_set_firmware_id(struct Instance*xsp, unsigned long arg)
+{
+      struct ucrx_firmware_id_s args;
+
+      if (copy_from_user(&args, (void*)arg, sizeof args) != 0)
+	    return -EFAULT;
+
+      if (memchr(args.id, 0, sizeof args.id) == 0)
+	    return -EINVAL;
+
+      memcpy(xsp->firmware_id, args.id, sizeof xsp->firmware_id);
+
+      if (debug_flag&UCR_TRACE_UCRX)
+	    printk("ucrx: firmware id %s\n", xsp->firmware_id);
+
+      return 0;
+}
+
+static int ucrx_get_firmware_id(struct Instance*xsp, unsigned long arg)
+{
+      if (copy_to_user((void*)arg, xsp->firmware_id,
+		       sizeof xsp->firmware_id) != 0)
+	    return -EFAULT;
+
+      return 0;
+}
+
+static int ucrx_set_prom_ident(struct Instance*xsp, unsigned long arg)
+{
+      struct ucrx_prom_ident_s*args;
+
+	/* The argument is too big for the kernel stack. */
+      args = kmalloc(sizeof(struct ucrx_prom_ident_s), GFP_KERNEL);
+      if (args == 0)
+	    return -ENOMEM;
+
+      if (copy_from_user(args, (void*)arg, sizeof *args) != 0) {
+	    kfree(args);
+	    return -EFAULT;
+      }
+
+      if (memchr(args->ident, 0, sizeof args->ident) == 0) {
+	    kfree(args);
 	    return -EINVAL;
       }
 
+      memcpy(xsp->prom_ident, args->ident, sizeof xsp->prom_ident);
+      kfree(args);
+
+      if (debug_flag&UCR_TRACE_UCRX)
+	    printk("ucrx: prom ident set (%u bytes)\n",
+		   (unsigned)strlen(xsp->prom_ident));
+
       return 0;
 }
 
+static int ucrx_get_prom_ident(struct Instance*xsp, unsigned long arg)
+{
+      if (copy_to_user((void*)arg, xsp->prom_ident,
+		       sizeof xsp->prom_ident) != 0)
+	    return -EFAULT;
 
-int ucrx_open(struct Instance*xsp)
+      return 0;
+}
+
+
+int ucrx_open(struct Instance*xsp, struct ControlData*cdp)
 {
+      cdp->frame_event_seen = xsp->frame_event_count;
       return 0;
 }
 
-void ucrx_release(struct Instance*xsp)
+void ucrx_release(struct Instance*xsp, struct ControlData*cdp)
 {
+	/* Do not leave a root table batch open after the control
+	   device that began it is closed. Other opens of the control
+	   device leave it alone. */
+      ucr_root_batch(xsp, cdp, 0);
 }
 
-int ucrx_ioctl(struct Instance*xsp, unsigned int cmd, unsigned long arg)
+/*
+ * Reading the control device returns the frame done sequence numbers
+ * from the frame events page, but only after a frame done bell that
+ * this open has not yet seen.
+ */
+long ucrx_read(struct Instance*xsp, struct ControlData*cdp,
+	       char*bytes, unsigned long count, int block_flag)
+{
+      wait_queue_t wait_cell;
+
+      if (xsp->frame_events == 0)
+	    return -EINVAL;
+
+      if (count > sizeof xsp->frame_events->done_seq)
+	    count = sizeof xsp->frame_events->done_seq;
+      count &= ~3UL;
+      if (count == 0)
+	    return -EINVAL;
+
+      if (cdp->frame_event_seen == xsp->frame_event_count && !block_flag)
+	    return -EAGAIN;
+
+      init_waitqueue_entry(&wait_cell, current);
+      add_wait_queue(&xsp->frame_event_sync, &wait_cell);
+      set_current_state(TASK_INTERRUPTIBLE);
+      while (cdp->frame_event_seen == xsp->frame_event_count
+	     && xsp->frame_events && !signal_pending(current)) {
+	    schedule();
+	    set_current_state(TASK_INTERRUPTIBLE);
+      }
+      set_current_state(TASK_RUNNING);
+      remove_wait_queue(&xsp->frame_event_sync, &wait_cell);
+
+      if (xsp->frame_events == 0)
+	    return -EIO;
+      if (cdp->frame_event_seen == xsp->frame_event_count)
+	    return -ERESTARTSYS;
+
+	/* Note the count before copying out the numbers, so that a
+	   bell during the copy makes the next read ready. */
+      cdp->frame_event_seen = xsp->frame_event_count;
+
+      if (copy_to_user(bytes, xsp->frame_events->done_seq, count) != 0)
+	    return -EFAULT;
+
+      return count;
+}
+
+int ucrx_ioctl(struct Instance*xsp, struct ControlData*cdp,
+	       unsigned int cmd, unsigned long arg)
 {
       switch (cmd) {
 
@@ -375,6 +716,12 @@ int ucrx_ioctl(struct Instance*xsp, unsigned int cmd, unsigned long arg)
 	  case UCRX_RUN_PROGRAM:
 	    return ucrx_run_program(xsp);
 
+	  case UCRX_RUN_PROGRAM_WAIT:
+	    return ucrx_run_program_wait(xsp, arg);
+
+	  case UCRX_HEARTBEAT:
+	    return ucrx_heartbeat(xsp, arg);
+
 	  case UCRX_DIAGNOSE:
 	    return ucrx_diagnose(xsp, arg);
 
@@ -387,7 +734,35 @@ int ucrx_ioctl(struct Instance*xsp, unsigned int cmd, unsigned long arg)
 	  case UCRX_TIMEOUT:
 	    return ucrx_timeout(xsp, arg);
 
+	  case UCRX_TIMEOUT_US:
+	    return ucrx_timeout_us(xsp, arg);
+
+	  case UCRX_FRAME_EVENTS:
+	    if (debug_flag&UCR_TRACE_UCRX)
+		  printk("ucrx: frame events %s\n", arg? "on" : "off");
+	    return ucr_frame_events(xsp, arg != 0);
+
+	  case UCRX_SET_FIRMWARE_ID:
+	    return ucrx_set_firmware_id(xsp, arg);
+
+	  case UCRX_GET_FIRMWARE_ID:
+	    return ucrx_get_firmware_id(xsp, arg);
+
+	  case UCRX_SET_PROM_IDENT:
+	    return ucrx_set_prom_ident(xsp, arg);
+
+	  case UCRX_GET_PROM_IDENT:
+	    return ucrx_get_prom_ident(xsp, arg);
+
+	  case UCRX_ROOT_BATCH:
+	    if (debug_flag&UCR_TRACE_UCRX)
+		  printk("ucrx: root batch %s\n", arg? "begin" : "commit");
+	    return ucr_root_batch(xsp, cdp, arg != 0);
+
 	  case UCRX_REMOVE:
+	      /* The board may be replaced with a different one, and
+		 the PROM ident with it. */
+	    xsp->prom_ident[0] = 0;
 	    return xsp->dev_ops->soft_remove
 		  ? xsp->dev_ops->soft_remove(xsp)
 		  : -ENOTTY;
@@ -21,15 +21,21 @@
 # include  "DeviceThread.h"
 # include  <QTimer>
 # include  <QStringList>
+# include  <cstring>
 # include  <iostream>
 # include  <cstdio>
 # include  <assert.h>
 
 using namespace std;
 
-DeviceThread::DeviceThread(QObject*parent)
-: QThread(parent), clock_(parent)
+DeviceThread::DeviceThread(ScopePipeline*pipe, QObject*parent)
+: QThread(parent), pipe_(pipe), clock_(this)
 {
+	// Move this object (and with it the clock_) into the thread
+	// that it starts, so that queued signals to the slots and the
+	// timer ticks are handled by the thread and not by the GUI.
+      moveToThread(this);
+
       dev_ = 0;
       dev_frame_ = 0;
       dev_frame_size_ = 0;
@@ -42,7 +48,10 @@ DeviceThread::DeviceThread(QObject*parent)
 
 DeviceThread::~DeviceThread()
 {
-      assert(dev_ == 0);
+	// The thread is stopped by now, so it is safe to close the
+	// board from here.
+      if (dev_ != 0)
+	    ise_close(dev_);
 }
 
 void DeviceThread::run()
@@ -88,7 +97,10 @@ void DeviceThread::attach_board(const QString&text)
       ise_rc = ise_channel(dev_, 3);
       assert(ise_rc == ISE_OK);
 
+	// The whole frame is read every time the video is grabbed,
+	// so map it all at once instead of taking a fault per page.
       dev_frame_size_ = 3*1024*1024;
+      ise_frame_prefault(dev_, 0, 1);
       dev_frame_ = ise_make_frame(dev_, 0, &dev_frame_size_);
 
 	// Get the diagjse version string
@@ -174,6 +186,50 @@ void DeviceThread::enable_live_mode(int state)
       }
 }
 
+/*
+ * Read a frame from the board and pass a copy of it to the reduction
+ * stage. If the reduction stage still has all the frames of the pool,
+ * then the frame is dropped here.
+ */
+void DeviceThread::acquire_frame_(void)
+{
+      double t_start = ScopePipeline::now_ms();
+
+      ise_writeln(dev_, 3, "<rd>read 0");
+      do {
+	    ise_readln(dev_, 3, buf_, sizeof buf_);
+      } while (strncmp(buf_, "<rd>", 4) != 0);
+
+      unsigned wid, hei, dep;
+      int cnt = sscanf(buf_, "<rd>video %ux%ux%u", &wid, &hei, &dep);
+      if (cnt != 3) {
+	    cerr << "ERROR: Got from read 0:" << buf_ << endl;
+      }
+      assert(cnt == 3);
+
+      if ((size_t)wid * hei * dep > dev_frame_size_)
+	    hei = dev_frame_size_ / ((size_t)wid * dep);
+      if ((size_t)wid * hei * dep == 0)
+	    return;
+
+      ScopeFrame*frame = pipe_->get_free();
+      if (frame == 0) {
+	    pipe_->drop(ScopePipeline::ACQUIRE);
+	    return;
+      }
+
+      size_t size = (size_t)wid * hei * dep;
+      frame->data.resize(size);
+      memcpy(&frame->data[0], dev_frame_, size);
+      frame->wid = wid;
+      frame->hei = hei;
+      frame->dep = dep;
+      frame->t_acquire = t_start;
+
+      pipe_->record(ScopePipeline::ACQUIRE, t_start);
+      pipe_->submit(frame);
+}
+
 void DeviceThread::clock_slot_(void)
 {
       if (dev_ == 0) {
@@ -228,79 +284,7 @@ void DeviceThread::clock_slot_(void)
 	    ise_writeln(dev_, 3, "get readable");
 	    ise_readln(dev_, 3, buf_, sizeof buf_);
 
-	    if (QString(buf_).toUInt() > 0) {
-		  ise_writeln(dev_, 3, "<rd>read 0");
-		  do {
-			ise_readln(dev_, 3, buf_, sizeof buf_);
-		  } while (strncmp(buf_, "<rd>", 4) != 0);
-
-		  unsigned wid, hei, dep;
-		  int cnt = sscanf(buf_, "<rd>video %ux%ux%u", &wid, &hei, &dep);
-		  if (cnt != 3) {
-			cerr << "ERROR: Got from read 0:" << buf_ << endl;
-		  }
-		  assert(cnt == 3);
-
-		  for (unsigned idx = 0 ; idx < wid ; idx += 1) {
-			red_line_[idx] = 0;
-			gre_line_[idx] = 0;
-			blu_line_[idx] = 0;
-		  }
-
-		  if (wid * hei * dep > dev_frame_size_)
-			hei = dev_frame_size_ / (wid * dep);
-
-		  int roff = 0;
-		  int goff = dep>1? 1 : 0;
-		  int boff = dep>1? 2 : 0;
-		  unsigned char*dp = (unsigned char*)dev_frame_;
-		  for (unsigned idx = 0 ; idx < wid*hei ; idx += 1, dp += dep) {
-			unsigned pix = idx % wid;
-			red_line_[pix] += dp[roff];
-			gre_line_[pix] += dp[goff];
-			blu_line_[pix] += dp[boff];
-		  }
-
-		  for (unsigned idx = 0 ; idx < wid ; idx += 1) {
-			red_line_[idx] /= hei;
-			gre_line_[idx] /= hei;
-			blu_line_[idx] /= hei;
-		  }
-
-		  QImage chart (wid, 256, QImage::Format_RGB32);
-		  for (int y = 0 ; y < chart.height() ; y += 1) {
-			int idy = chart.height()-y-1;
-			int r = 0;
-			int g = 0;
-			int b = 0;
-			for (unsigned idx = 0 ; idx < wid ; idx += 1) {
-			      if (y == red_line_[idx])
-				    r = 255;
-			      else if (y < red_line_[idx])
-				    r = 32;
-			      else
-				    r = 0;
-				    
-			      if (y == gre_line_[idx])
-				    g = 255;
-			      else if (y < gre_line_[idx])
-				    g = 32;
-			      else
-				    g = 0;
-				    
-			      if (y == blu_line_[idx])
-				    b = 255;
-			      else if (y < blu_line_[idx])
-				    b = 32;
-			      else
-				    b = 0;
-
-			      QRgb pix = qRgb(r, g, b);
-			      chart.setPixel(idx, idy, pix);
-			}
-		  }
-		  chart_ = chart;
-		  emit live_display(chart_);
-	    }
+	    if (QString(buf_).toUInt() > 0)
+		  acquire_frame_();
       }
 }
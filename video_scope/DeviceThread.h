@@ -25,17 +25,21 @@
 # include  <QImage>
 # include  <libiseio.h>
 # include  <stddef.h>
+# include  "ScopePipeline.h"
 
 /*
  * Use an instance of the DeviceThread to control a device. The thread
  * receives commands (via its slots) and sends events out via signals.
+ * The object lives in its own thread, so the slots and the board I/O
+ * run there and not in the GUI thread. In live mode, it is the
+ * acquisition stage of the ScopePipeline.
  */
 class DeviceThread  : public QThread {
 
       Q_OBJECT
 
     public:
-      DeviceThread(QObject*parent =0);
+      DeviceThread(ScopePipeline*pipe, QObject*parent =0);
       ~DeviceThread();
 
     public slots:
@@ -55,8 +59,6 @@ class DeviceThread  : public QThread {
 	// Signal the measured video width.
       void video0_width(unsigned wid);
       void video1_width(unsigned wid);
-	// Signal that a new live-display is ready.
-      void live_display(const QImage&chart);
 
     private slots:
       void clock_slot_(void);
@@ -64,6 +66,7 @@ class DeviceThread  : public QThread {
     private:
       void run();
       void activate_live_mode_(bool);
+      void acquire_frame_(void);
 
     private:
       struct ise_handle* dev_;
@@ -72,10 +75,7 @@ class DeviceThread  : public QThread {
 
       char buf_[4096];
 
-      QImage chart_;
-      unsigned long red_line_[64*1024];
-      unsigned long gre_line_[64*1024];
-      unsigned long blu_line_[64*1024];
+      ScopePipeline*pipe_;
 
 	// Measured video width, or 0 if not measured yet.
       unsigned video0_width_;
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  "ImageStats.h"
+# include  <pthread.h>
+# include  <unistd.h>
+# include  <string.h>
+# include  <assert.h>
+#ifdef __SSE2__
+# include  <emmintrin.h>
+#endif
+
+using namespace std;
+
+/*
+ * The rows are worked on as runs of bytes, without regard to which
+ * plane each byte belongs to, and the bytes are sorted into planes
+ * only at the end. The samples are first summed into 16bit column
+ * accumulators, which cannot overflow for ACC_ROWS rows of 8bit
+ * samples, and those are added into the full sums every ACC_ROWS
+ * rows. The min/max is kept per byte position modulo CHUNK, which is
+ * a multiple of every supported pixel depth and of the SSE2 vector.
+ */
+static const unsigned ACC_ROWS = 256;
+static const unsigned CHUNK = 48;
+
+	// Bands smaller than this are not worth a thread.
+static const unsigned MIN_BAND_ROWS = 16;
+
+struct ImageStats::band_t {
+      const unsigned char*img;
+      size_t stride;
+      unsigned nbytes;
+      unsigned nrows;
+      unsigned dep;
+      unsigned what;
+
+      vector<unsigned long> sum;
+      vector<unsigned short> acc;
+      unsigned long hist[MAX_PLANES][256];
+      unsigned char lo[CHUNK];
+      unsigned char hi[CHUNK];
+};
+
+ImageStats::ImageStats()
+{
+      nthreads_ = 0;
+      wid_ = 0;
+      hei_ = 0;
+      dep_ = 1;
+      memset(hist_, 0, sizeof hist_);
+      for (unsigned pl = 0 ; pl < MAX_PLANES ; pl += 1) {
+	    min_[pl] = 0;
+	    max_[pl] = 0;
+      }
+}
+
+ImageStats::~ImageStats()
+{
+}
+
+void ImageStats::set_threads(unsigned nthreads)
+{
+      nthreads_ = nthreads;
+}
+
+static void flush_acc(unsigned long*sum, unsigned short*acc, unsigned nbytes)
+{
+      for (unsigned idx = 0 ; idx < nbytes ; idx += 1) {
+	    sum[idx] += acc[idx];
+	    acc[idx] = 0;
+      }
+}
+
+void ImageStats::collect_band_(band_t*band)
+{
+      const unsigned nbytes = band->nbytes;
+      const unsigned dep = band->dep;
+      const bool columns = (band->what & COLUMNS) != 0;
+      const bool minmax = (band->what & MINMAX) != 0;
+      const bool histogram = (band->what & HISTOGRAM) != 0;
+
+      unsigned long*sum = 0;
+      unsigned short*acc = 0;
+      if (columns) {
+	    band->sum.assign(nbytes, 0);
+	    band->acc.assign(nbytes, 0);
+	    sum = &band->sum[0];
+	    acc = &band->acc[0];
+      }
+
+      memset(band->hist, 0, sizeof band->hist);
+      memset(band->lo, 0xff, sizeof band->lo);
+      memset(band->hi, 0x00, sizeof band->hi);
+
+	// The whole CHUNKs of each row are done here, and the rest
+	// of the row by the scalar loop below.
+      const unsigned nvec = nbytes - nbytes%CHUNK;
+
+#ifdef __SSE2__
+      const __m128i zero = _mm_setzero_si128();
+      __m128i vlo[CHUNK/16], vhi[CHUNK/16];
+      for (unsigned c = 0 ; c < CHUNK/16 ; c += 1) {
+	    vlo[c] = _mm_set1_epi8((char)0xff);
+	    vhi[c] = zero;
+      }
+#endif
+
+      unsigned acc_rows = 0;
+      for (unsigned row = 0 ; row < band->nrows ; row += 1) {
+	    const unsigned char*src = band->img + row*band->stride;
+	    unsigned idx = 0;
+
+#ifdef __SSE2__
+	    if (columns || minmax) {
+		  for (idx = 0 ; idx < nvec ; idx += CHUNK) {
+			for (unsigned c = 0 ; c < CHUNK/16 ; c += 1) {
+			      unsigned off = idx + 16*c;
+			      __m128i v = _mm_loadu_si128((const __m128i*)(src+off));
+			      if (minmax) {
+				    vlo[c] = _mm_min_epu8(vlo[c], v);
+				    vhi[c] = _mm_max_epu8(vhi[c], v);
+			      }
+			      if (columns) {
+				    __m128i*ap = (__m128i*)(acc+off);
+				    __m128i a0 = _mm_loadu_si128(ap+0);
+				    __m128i a1 = _mm_loadu_si128(ap+1);
+				    a0 = _mm_add_epi16(a0, _mm_unpacklo_epi8(v, zero));
+				    a1 = _mm_add_epi16(a1, _mm_unpackhi_epi8(v, zero));
+				    _mm_storeu_si128(ap+0, a0);
+				    _mm_storeu_si128(ap+1, a1);
+			      }
+			}
+		  }
+	    }
+#endif
+
+	    for (unsigned pos = idx ; (columns||minmax) && pos < nbytes ; pos += 1) {
+		  unsigned char val = src[pos];
+		  if (columns)
+			acc[pos] += val;
+		  if (minmax) {
+			unsigned k = pos % CHUNK;
+			if (val < band->lo[k]) band->lo[k] = val;
+			if (val > band->hi[k]) band->hi[k] = val;
+		  }
+	    }
+
+	    if (histogram) {
+		  for (unsigned pos = 0 ; pos < nbytes ; pos += dep) {
+			for (unsigned pl = 0 ; pl < dep ; pl += 1)
+			      band->hist[pl][src[pos+pl]] += 1;
+		  }
+	    }
+
+	    if (columns && ++acc_rows == ACC_ROWS) {
+		  flush_acc(sum, acc, nbytes);
+		  acc_rows = 0;
+	    }
+      }
+
+      if (columns)
+	    flush_acc(sum, acc, nbytes);
+
+#ifdef __SSE2__
+      if (minmax) {
+	    unsigned char tmp[CHUNK/16][16];
+	    for (unsigned c = 0 ; c < CHUNK/16 ; c += 1) {
+		  _mm_storeu_si128((__m128i*)tmp[c], vlo[c]);
+		  for (unsigned k = 0 ; k < 16 ; k += 1)
+			if (tmp[c][k] < band->lo[16*c+k])
+			      band->lo[16*c+k] = tmp[c][k];
+		  _mm_storeu_si128((__m128i*)tmp[c], vhi[c]);
+		  for (unsigned k = 0 ; k < 16 ; k += 1)
+			if (tmp[c][k] > band->hi[16*c+k])
+			      band->hi[16*c+k] = tmp[c][k];
+	    }
+      }
+#endif
+}
+
+void* ImageStats::band_thread_(void*arg)
+{
+      collect_band_((band_t*)arg);
+      return 0;
+}
+
+void ImageStats::collect(const unsigned char*img, unsigned wid, unsigned hei,
+			 unsigned dep, size_t stride, unsigned what)
+{
+      assert(dep >= 1 && dep <= MAX_PLANES);
+
+      wid_ = wid;
+      hei_ = hei;
+      dep_ = dep;
+      if (stride == 0)
+	    stride = (size_t)wid * dep;
+
+      unsigned nbytes = wid * dep;
+
+	// Decide how many bands to split the rows into.
+      unsigned nbands = nthreads_;
+      if (nbands == 0) {
+	    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	    nbands = ncpu > 0? ncpu : 1;
+      }
+      if (nbands > hei / MIN_BAND_ROWS)
+	    nbands = hei / MIN_BAND_ROWS;
+      if (nbands == 0)
+	    nbands = 1;
+
+      vector<band_t> bands (nbands);
+      unsigned row = 0;
+      for (unsigned idx = 0 ; idx < nbands ; idx += 1) {
+	    unsigned nrows = hei / nbands + (idx < hei%nbands? 1 : 0);
+	    bands[idx].img = img + row*stride;
+	    bands[idx].stride = stride;
+	    bands[idx].nbytes = nbytes;
+	    bands[idx].nrows = nrows;
+	    bands[idx].dep = dep;
+	    bands[idx].what = what;
+	    row += nrows;
+      }
+
+	// The first band is done by this thread while the others
+	// do the rest. If a thread cannot be started, then do its
+	// band here instead.
+      vector<pthread_t> tids (nbands);
+      vector<bool> started (nbands, false);
+      for (unsigned idx = 1 ; idx < nbands ; idx += 1) {
+	    int rc = pthread_create(&tids[idx], 0, &band_thread_, &bands[idx]);
+	    started[idx] = rc == 0;
+      }
+
+      collect_band_(&bands[0]);
+      for (unsigned idx = 1 ; idx < nbands ; idx += 1) {
+	    if (started[idx])
+		  pthread_join(tids[idx], 0);
+	    else
+		  collect_band_(&bands[idx]);
+      }
+
+	// Combine the results of the bands.
+      if (what & COLUMNS) {
+	    col_sum_.assign(nbytes, 0);
+	    for (unsigned idx = 0 ; idx < nbands ; idx += 1) {
+		  const unsigned long*src = &bands[idx].sum[0];
+		  for (unsigned pos = 0 ; pos < nbytes ; pos += 1)
+			col_sum_[pos] += src[pos];
+	    }
+      }
+
+      memset(hist_, 0, sizeof hist_);
+      if (what & HISTOGRAM) {
+	    for (unsigned idx = 0 ; idx < nbands ; idx += 1)
+		  for (unsigned pl = 0 ; pl < dep ; pl += 1)
+			for (unsigned bin = 0 ; bin < 256 ; bin += 1)
+			      hist_[pl][bin] += bands[idx].hist[pl][bin];
+      }
+
+      for (unsigned pl = 0 ; pl < MAX_PLANES ; pl += 1) {
+	    min_[pl] = 255;
+	    max_[pl] = 0;
+      }
+      if (what & MINMAX) {
+	    for (unsigned idx = 0 ; idx < nbands ; idx += 1) {
+		  for (unsigned k = 0 ; k < CHUNK && k < nbytes ; k += 1) {
+			unsigned pl = k % dep;
+			if (bands[idx].lo[k] < min_[pl])
+			      min_[pl] = bands[idx].lo[k];
+			if (bands[idx].hi[k] > max_[pl])
+			      max_[pl] = bands[idx].hi[k];
+		  }
+	    }
+      }
+      if (!(what & MINMAX) || nbytes == 0 || hei == 0) {
+	    for (unsigned pl = 0 ; pl < MAX_PLANES ; pl += 1)
+		  min_[pl] = 0;
+      }
+}
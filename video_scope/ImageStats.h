@@ -0,0 +1,99 @@
+#ifndef __ImageStats_H
+#define __ImageStats_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  <vector>
+# include  <stddef.h>
+
+/*
+ * An ImageStats object collects statistics of an 8bit-per-sample
+ * image with interleaved planes (i.e. RGB) of up to 4 planes. The
+ * collect method takes the image, and the results are available from
+ * the other methods until the next collect.
+ *
+ * The rows of the image are split into bands that are summed by
+ * separate threads, and the inner loops use SSE2 where the compiler
+ * supports it. The object is not itself thread safe; use one object
+ * per thread that collects.
+ */
+class ImageStats {
+
+    public:
+      enum { MAX_PLANES = 4 };
+
+	// Select which statistics collect gathers. The column sums
+	// and the min/max are cheap; the histograms cost a table
+	// update per sample.
+      enum { COLUMNS = 0x01, MINMAX = 0x02, HISTOGRAM = 0x04 };
+
+      ImageStats();
+      ~ImageStats();
+
+	// Set the number of threads to use. 0 (the default) uses one
+	// thread per online processor.
+      void set_threads(unsigned nthreads);
+
+	// Collect the selected statistics of the image. The image
+	// has hei rows of wid pixels, each dep bytes, and the rows
+	// are stride bytes apart. A stride of 0 means wid*dep.
+      void collect(const unsigned char*img, unsigned wid, unsigned hei,
+		   unsigned dep, size_t stride =0,
+		   unsigned what =COLUMNS|MINMAX);
+
+      unsigned width() const  { return wid_; }
+      unsigned height() const { return hei_; }
+      unsigned planes() const { return dep_; }
+
+	// Sum of the samples of the plane in column x.
+      unsigned long column_sum(unsigned plane, unsigned x) const
+      { return col_sum_[x*dep_ + plane]; }
+
+	// Average of the samples of the plane in column x.
+      unsigned column_mean(unsigned plane, unsigned x) const
+      { return hei_? col_sum_[x*dep_ + plane] / hei_ : 0; }
+
+	// The 256 bin histogram of the plane.
+      const unsigned long*histogram(unsigned plane) const
+      { return hist_[plane]; }
+
+      unsigned min(unsigned plane) const { return min_[plane]; }
+      unsigned max(unsigned plane) const { return max_[plane]; }
+
+    private:
+      struct band_t;
+      static void*band_thread_(void*arg);
+      static void collect_band_(band_t*band);
+
+    private:
+      unsigned nthreads_;
+
+      unsigned wid_, hei_, dep_;
+      std::vector<unsigned long> col_sum_;
+      unsigned long hist_[MAX_PLANES][256];
+      unsigned min_[MAX_PLANES];
+      unsigned max_[MAX_PLANES];
+
+    private: // not implemented
+      ImageStats(const ImageStats&);
+      ImageStats& operator= (const ImageStats&);
+};
+
+#endif
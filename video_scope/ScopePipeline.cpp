@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  "ScopePipeline.h"
+# include  <QMutexLocker>
+# include  <time.h>
+# include  <assert.h>
+
+using namespace std;
+
+static const char*stage_names[ScopePipeline::STAGE_COUNT] = {
+      "acquire", "reduce", "render"
+};
+
+ScopePipeline::ScopePipeline(unsigned depth, QObject*parent)
+: QObject(parent)
+{
+      assert(depth > 0);
+      for (unsigned idx = 0 ; idx < depth ; idx += 1) {
+	    ScopeFrame*frame = new ScopeFrame;
+	    frame->wid = 0;
+	    frame->hei = 0;
+	    frame->dep = 0;
+	    frame->t_acquire = 0.0;
+	    frame->t_queued = 0.0;
+	    frames_.push_back(frame);
+	    free_.push_back(frame);
+      }
+
+      stop_flag_ = false;
+      chart_t_ = 0.0;
+      chart_flag_ = false;
+
+      for (unsigned idx = 0 ; idx < STAGE_COUNT ; idx += 1) {
+	    stats_[idx].count = 0;
+	    stats_[idx].drops = 0;
+	    stats_[idx].win_count = 0;
+	    stats_[idx].win_latency = 0.0;
+      }
+      report_t_ = now_ms();
+}
+
+ScopePipeline::~ScopePipeline()
+{
+      for (unsigned idx = 0 ; idx < frames_.size() ; idx += 1)
+	    delete frames_[idx];
+}
+
+double ScopePipeline::now_ms()
+{
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+ScopeFrame* ScopePipeline::get_free()
+{
+      QMutexLocker locker (&lock_);
+      if (free_.empty())
+	    return 0;
+
+      ScopeFrame*frame = free_.front();
+      free_.pop_front();
+      return frame;
+}
+
+void ScopePipeline::submit(ScopeFrame*frame)
+{
+      QMutexLocker locker (&lock_);
+      frame->t_queued = now_ms();
+      filled_.push_back(frame);
+      filled_cond_.wakeOne();
+}
+
+ScopeFrame* ScopePipeline::take_filled()
+{
+      QMutexLocker locker (&lock_);
+      while (filled_.empty() && !stop_flag_)
+	    filled_cond_.wait(&lock_);
+
+      if (stop_flag_)
+	    return 0;
+
+      ScopeFrame*frame = filled_.front();
+      filled_.pop_front();
+      return frame;
+}
+
+void ScopePipeline::release(ScopeFrame*frame)
+{
+      QMutexLocker locker (&lock_);
+      free_.push_back(frame);
+}
+
+void ScopePipeline::stop()
+{
+      QMutexLocker locker (&lock_);
+      stop_flag_ = true;
+      filled_cond_.wakeAll();
+}
+
+void ScopePipeline::post_chart(const QImage&chart, double t_acquire)
+{
+      bool signal_flag;
+
+      { QMutexLocker locker (&lock_);
+	if (chart_flag_)
+	      stats_[RENDER].drops += 1;
+	chart_ = chart;
+	chart_t_ = t_acquire;
+	signal_flag = !chart_flag_;
+	chart_flag_ = true;
+      }
+
+	// If the GUI has not taken the previous chart yet, then it
+	// already has a signal on the way, and will get this chart.
+      if (signal_flag)
+	    emit chart_ready();
+}
+
+bool ScopePipeline::take_chart(QImage&chart, double&t_acquire)
+{
+      QMutexLocker locker (&lock_);
+      if (! chart_flag_)
+	    return false;
+
+      chart = chart_;
+      t_acquire = chart_t_;
+      chart_ = QImage();
+      chart_flag_ = false;
+      return true;
+}
+
+void ScopePipeline::record(stage_t stage, double t_start)
+{
+      double latency = now_ms() - t_start;
+
+      QMutexLocker locker (&lock_);
+      stats_[stage].count += 1;
+      stats_[stage].win_count += 1;
+      stats_[stage].win_latency += latency;
+}
+
+void ScopePipeline::drop(stage_t stage)
+{
+      QMutexLocker locker (&lock_);
+      stats_[stage].drops += 1;
+}
+
+QString ScopePipeline::report()
+{
+      QMutexLocker locker (&lock_);
+      double now = now_ms();
+      double span = (now - report_t_) / 1000.0;
+      report_t_ = now;
+
+      QString text;
+      for (unsigned idx = 0 ; idx < STAGE_COUNT ; idx += 1) {
+	    stage_stats_t&cur = stats_[idx];
+	    double rate = span > 0.0? cur.win_count / span : 0.0;
+	    double lat = cur.win_count? cur.win_latency / cur.win_count : 0.0;
+
+	    if (idx > 0)
+		  text += "  ";
+	    text += QString("%1: %2 fps %3 ms (%4 frames, %5 dropped)")
+		  .arg(stage_names[idx])
+		  .arg(rate, 0, 'f', 1)
+		  .arg(lat, 0, 'f', 1)
+		  .arg(cur.count)
+		  .arg(cur.drops);
+
+	    cur.win_count = 0;
+	    cur.win_latency = 0.0;
+      }
+
+      return text;
+}
+
+
+ReduceThread::ReduceThread(ScopePipeline*pipe, QObject*parent)
+: QThread(parent), pipe_(pipe)
+{
+}
+
+ReduceThread::~ReduceThread()
+{
+}
+
+void ReduceThread::run()
+{
+      ScopeFrame*frame;
+
+      while ( (frame = pipe_->take_filled()) ) {
+	    double t_queued = frame->t_queued;
+	    double t_acquire = frame->t_acquire;
+
+	    stats_.collect(&frame->data[0], frame->wid, frame->hei,
+			   frame->dep, 0, ImageStats::COLUMNS);
+	    pipe_->release(frame);
+
+	    QImage chart (stats_.width(), 256, QImage::Format_RGB32);
+	    render_chart_(chart);
+
+	    pipe_->record(ScopePipeline::REDUCE, t_queued);
+	    pipe_->post_chart(chart, t_acquire);
+      }
+}
+
+/*
+ * Draw the column profile of the last collected frame. Each column of
+ * the chart has a bright dot at the average of each color, and is
+ * dim below it. The chart is written a scanline at a time, so wide
+ * video does not cost a setPixel call per chart pixel.
+ */
+void ReduceThread::render_chart_(QImage&chart)
+{
+      const unsigned wid = chart.width();
+      const unsigned dep = stats_.planes();
+      const unsigned goff = dep>1? 1 : 0;
+      const unsigned boff = dep>2? 2 : 0;
+
+      vector<unsigned char> red (wid), gre (wid), blu (wid);
+      for (unsigned idx = 0 ; idx < wid ; idx += 1) {
+	    red[idx] = stats_.column_mean(0, idx);
+	    gre[idx] = stats_.column_mean(goff, idx);
+	    blu[idx] = stats_.column_mean(boff, idx);
+      }
+
+      for (int y = 0 ; y < chart.height() ; y += 1) {
+	    int idy = chart.height()-y-1;
+	    QRgb*line = (QRgb*)chart.scanLine(idy);
+	    for (unsigned idx = 0 ; idx < wid ; idx += 1) {
+		  int r = y == red[idx]? 255 : y < red[idx]? 32 : 0;
+		  int g = y == gre[idx]? 255 : y < gre[idx]? 32 : 0;
+		  int b = y == blu[idx]? 255 : y < blu[idx]? 32 : 0;
+		  line[idx] = qRgb(r, g, b);
+	    }
+      }
+}
@@ -0,0 +1,148 @@
+#ifndef __ScopePipeline_H
+#define __ScopePipeline_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    agent (agent@local)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+# include  <QObject>
+# include  <QThread>
+# include  <QMutex>
+# include  <QWaitCondition>
+# include  <QImage>
+# include  <QString>
+# include  <vector>
+# include  <deque>
+# include  "ImageStats.h"
+
+/*
+ * A ScopeFrame carries a copy of a video frame from the acquisition
+ * stage to the reduction stage. The times are in ms from now_ms.
+ */
+struct ScopeFrame {
+      std::vector<unsigned char> data;
+      unsigned wid, hei, dep;
+
+	// When the acquisition of the frame started, and when the
+	// frame was put in the reduction queue.
+      double t_acquire;
+      double t_queued;
+};
+
+/*
+ * The ScopePipeline connects the stages of the live display:
+ *
+ *   acquisition (DeviceThread) -> reduction (ReduceThread) -> render (GUI)
+ *
+ * The queues between the stages are bounded. There is a fixed pool of
+ * frames, and if the acquisition finds no free frame, it drops the
+ * frame it just read. The reduction passes only the latest chart to
+ * the render stage, and a chart that is replaced before the GUI takes
+ * it is dropped. So a slow GUI or reduction never backs up the board.
+ *
+ * The pipeline also keeps per-stage counters of frames, drops and
+ * latency for display.
+ */
+class ScopePipeline  : public QObject {
+
+      Q_OBJECT
+
+    public:
+      enum stage_t { ACQUIRE = 0, REDUCE, RENDER, STAGE_COUNT };
+
+      ScopePipeline(unsigned depth =2, QObject*parent =0);
+      ~ScopePipeline();
+
+	// Acquisition: Get an empty frame, or 0 if they are all in
+	// use. Fill it and pass it to submit.
+      ScopeFrame* get_free();
+      void submit(ScopeFrame*frame);
+
+	// Reduction: Wait for the next filled frame, or return 0 if
+	// the pipeline is stopped. Give the frame back with release,
+	// and pass the chart made from it to post_chart.
+      ScopeFrame* take_filled();
+      void release(ScopeFrame*frame);
+      void post_chart(const QImage&chart, double t_acquire);
+      void stop();
+
+	// Render: Take the latest chart. Return false if there is no
+	// new chart.
+      bool take_chart(QImage&chart, double&t_acquire);
+
+	// Count a frame through the stage, with the latency measured
+	// from t_start, or count a dropped frame.
+      void record(stage_t stage, double t_start);
+      void drop(stage_t stage);
+
+	// Summarize the counters. The rates are since the previous
+	// report.
+      QString report();
+
+      static double now_ms();
+
+    signals:
+	// Emitted when a chart is posted for a render stage that has
+	// taken the previous chart.
+      void chart_ready();
+
+    private:
+      QMutex lock_;
+      QWaitCondition filled_cond_;
+      std::vector<ScopeFrame*> frames_;
+      std::deque<ScopeFrame*> free_;
+      std::deque<ScopeFrame*> filled_;
+      bool stop_flag_;
+
+      QImage chart_;
+      double chart_t_;
+      bool chart_flag_;
+
+      struct stage_stats_t {
+	    unsigned long count;
+	    unsigned long drops;
+	    unsigned long win_count;
+	    double win_latency;
+      } stats_[STAGE_COUNT];
+      double report_t_;
+
+    private: // not implemented
+      ScopePipeline(const ScopePipeline&);
+      ScopePipeline& operator= (const ScopePipeline&);
+};
+
+/*
+ * The ReduceThread is the reduction stage. It turns each frame into
+ * the column profile chart.
+ */
+class ReduceThread  : public QThread {
+
+    public:
+      ReduceThread(ScopePipeline*pipe, QObject*parent =0);
+      ~ReduceThread();
+
+    private:
+      void run();
+      void render_chart_(QImage&chart);
+
+    private:
+      ScopePipeline*pipe_;
+      ImageStats stats_;
+};
+
+#endif
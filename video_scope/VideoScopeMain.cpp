@@ -28,7 +28,7 @@
 using namespace std;
 
 VideoScopeMain::VideoScopeMain(QWidget*parent)
-: QMainWindow(parent), device_(this)
+: QMainWindow(parent), pipe_(2), device_(&pipe_), reduce_(&pipe_)
 {
       ui.setupUi(this);
 
@@ -41,6 +41,7 @@ VideoScopeMain::VideoScopeMain(QWidget*parent)
 
       detect_ise_boards_();
       device_.start();
+      reduce_.start();
 
       connect(ui.attach_check,
 	      SIGNAL(stateChanged(int)),
@@ -73,13 +74,20 @@ VideoScopeMain::VideoScopeMain(QWidget*parent)
       connect(&device_, SIGNAL(video1_width(unsigned)),
 	      SLOT(video1_width_slot_(unsigned)));
 
-	// Receive a live_display chart image from the device.
-      connect(&device_, SIGNAL(live_display(const QImage&)),
-	      SLOT(live_display_slot_(const QImage&)));
+	// Receive live_display charts from the end of the pipeline.
+      connect(&pipe_, SIGNAL(chart_ready()), SLOT(live_display_slot_()));
+
+	// Show the pipeline counters in the status bar.
+      connect(&stats_clock_, SIGNAL(timeout()), SLOT(pipeline_stats_slot_()));
+      stats_clock_.start(1000);
 }
 
 VideoScopeMain::~VideoScopeMain()
 {
+      device_.quit();
+      device_.wait();
+      pipe_.stop();
+      reduce_.wait();
 }
 
 void VideoScopeMain::detect_ise_boards_(void)
@@ -130,8 +138,22 @@ void VideoScopeMain::video1_width_slot_(unsigned wid)
       ui.measured_width1_box->setText(tmp);
 }
 
-void VideoScopeMain::live_display_slot_(const QImage&chart)
+void VideoScopeMain::live_display_slot_(void)
 {
+      QImage chart;
+      double t_acquire;
+      if (! pipe_.take_chart(chart, t_acquire))
+	    return;
+
       live_display_pixmap_->setPixmap(QPixmap::fromImage(chart));
       live_display_scene_->update();
+
+	// The render latency is from the start of the acquisition, so
+	// it is the latency of the whole pipeline.
+      pipe_.record(ScopePipeline::RENDER, t_acquire);
+}
+
+void VideoScopeMain::pipeline_stats_slot_(void)
+{
+      ui.statusbar->showMessage(pipe_.report());
 }
@@ -23,6 +23,8 @@
 # include  <qapplication.h>
 # include  "ui_video_scope.h"
 # include  "DeviceThread.h"
+# include  "ScopePipeline.h"
+# include  <QTimer>
 
 class QGraphicsScene;
 class QGraphicsPixmapItem;
@@ -42,7 +44,8 @@ class VideoScopeMain  : public QMainWindow {
       void attach_check_slot_(int state);
       void video0_width_slot_(unsigned wid);
       void video1_width_slot_(unsigned wid);
-      void live_display_slot_(const QImage&chart);
+      void live_display_slot_(void);
+      void pipeline_stats_slot_(void);
 
     signals:
       void attach_board(const QString&);
@@ -51,7 +54,14 @@ class VideoScopeMain  : public QMainWindow {
       Ui::VideoScope ui;
       QGraphicsScene*live_display_scene_;
       QGraphicsPixmapItem*live_display_pixmap_;
+
+	// The live display pipeline. The device_ is the acquisition
+	// stage, the reduce_ thread the reduction stage, and this
+	// window renders.
+      ScopePipeline pipe_;
       DeviceThread device_;
+      ReduceThread reduce_;
+      QTimer stats_clock_;
 };
 
 #endif
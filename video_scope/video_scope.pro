@@ -1,7 +1,7 @@
 
 CONFIG += qt
 FORMS += video_scope.ui
-HEADERS += VideoScopeMain.h DeviceThread.h
-SOURCES += main.cpp VideoScopeMain.cpp DeviceThread.cpp
+HEADERS += VideoScopeMain.h DeviceThread.h ImageStats.h ScopePipeline.h
+SOURCES += main.cpp VideoScopeMain.cpp DeviceThread.cpp ImageStats.cpp ScopePipeline.cpp
 
 unix:LIBS += -liseio